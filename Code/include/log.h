@@ -66,7 +66,20 @@
 
 // output function for printing, default is printf
 // the advantage of using this is that we can define it to log to a file or something else as well, without changing anything else
+// with LOG_ASYNC set to 1 (make LOG_ASYNC=1) it records the format and arguments in a per thread ring buffer instead, and a background thread does the printing (see log_async.h)
+#ifndef LOG_ASYNC
+#define LOG_ASYNC 0
+#endif
+
+// LOG_FLUSH writes out what LOG_OUT has printed so far, before output that goes around it, e.g. to stdout with fprintf
+#if LOG_ASYNC
+#include "log_async.h"
+#define LOG_OUT(...) LOG_ASYNC_WRITE(__VA_ARGS__)
+#define LOG_FLUSH() log_async_flush()
+#else
 #define LOG_OUT(...) printf(__VA_ARGS__)
+#define LOG_FLUSH() fflush(stdout)
+#endif
 
 // defines the annotation string.
 // if you want to change the format of the annotation, change the above macros and this string. the annotation string is simply "file,function,line" depending on the above macros
@@ -0,0 +1,128 @@
+/**
+ * @file log_async.h
+ * @brief Asynchronous backend of LOG_OUT, selected with LOG_ASYNC=1 (see log.h).
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * A call records the format pointer and its raw arguments in a ring buffer of the calling thread, without formatting anything or taking a lock.
+ * A background thread, started by the first call, formats the records and writes them to stdout, and whatever is left is written at exit.
+ * Messages of one thread keep their order, messages of different threads are interleaved by the drain thread.
+ *
+ * The format must outlive the call (a string literal), the strings passed for %s are copied into the record, up to LOG_ASYNC_STRING_BYTES per record.
+ * A call takes at most LOG_ASYNC_MAX_ARGS arguments after the format, %n isn't supported. Messages still in the rings when the program crashes are lost.
+ */
+
+#ifndef LOG_ASYNC_H
+#define LOG_ASYNC_H
+
+#include <stddef.h>
+
+#define LOG_ASYNC_MAX_ARGS 16
+#define LOG_ASYNC_STRING_BYTES 192
+
+// records per thread, a thread that fills its ring waits for the drain thread
+#define LOG_ASYNC_RING_RECORDS 256
+
+typedef enum
+{
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER
+} log_arg_type_t;
+
+typedef union
+{
+    long long i;
+    unsigned long long u;
+    double d;
+    const char *s;
+    const void *p;
+} log_value_t;
+
+typedef struct
+{
+    log_arg_type_t type;
+    log_value_t value;
+} log_arg_t;
+
+static inline log_arg_t log_arg_int(long long value) { return (log_arg_t){LOG_ARG_INT, {.i = value}}; }
+static inline log_arg_t log_arg_uint(unsigned long long value) { return (log_arg_t){LOG_ARG_UINT, {.u = value}}; }
+static inline log_arg_t log_arg_double(long double value) { return (log_arg_t){LOG_ARG_DOUBLE, {.d = (double)value}}; }
+static inline log_arg_t log_arg_string(const char *value) { return (log_arg_t){LOG_ARG_STRING, {.s = value}}; }
+static inline log_arg_t log_arg_pointer(const void *value) { return (log_arg_t){LOG_ARG_POINTER, {.p = value}}; }
+
+// the raw value of an argument, tagged with its type. enums match their integer type, any other pointer is recorded as a pointer
+#define LOG_ARG(x) _Generic((x),                                                                               \
+    _Bool: log_arg_uint, unsigned char: log_arg_uint, unsigned short: log_arg_uint, unsigned int: log_arg_uint,  \
+    unsigned long: log_arg_uint, unsigned long long: log_arg_uint,                                              \
+    char: log_arg_int, signed char: log_arg_int, short: log_arg_int, int: log_arg_int, long: log_arg_int,       \
+    long long: log_arg_int,                                                                                     \
+    float: log_arg_double, double: log_arg_double, long double: log_arg_double,                                 \
+    char *: log_arg_string, const char *: log_arg_string,                                                       \
+    default: log_arg_pointer)(x)
+
+#define LOG_ASYNC_ARGS_1(a) LOG_ARG(a)
+#define LOG_ASYNC_ARGS_2(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_1(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_3(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_2(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_4(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_3(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_5(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_4(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_6(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_5(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_7(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_6(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_8(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_7(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_9(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_8(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_10(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_9(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_11(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_10(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_12(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_11(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_13(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_12(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_14(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_13(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_15(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_14(__VA_ARGS__)
+#define LOG_ASYNC_ARGS_16(a, ...) LOG_ARG(a), LOG_ASYNC_ARGS_15(__VA_ARGS__)
+
+// number of arguments, up to LOG_ASYNC_MAX_ARGS + 1
+#define LOG_ASYNC_COUNT(...) LOG_ASYNC_COUNT_(__VA_ARGS__, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define LOG_ASYNC_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, count, ...) count
+#define LOG_ASYNC_CAT(a, b) LOG_ASYNC_CAT_(a, b)
+#define LOG_ASYNC_CAT_(a, b) a##b
+
+// LOG_ASYNC_WRITE(format, ...) takes the arguments of printf, a format alone is recorded without arguments
+#define LOG_ASYNC_WRITE(...) LOG_ASYNC_CAT(LOG_ASYNC_WRITE_, LOG_ASYNC_CAT(LOG_ASYNC_KIND_, LOG_ASYNC_COUNT(__VA_ARGS__)))(__VA_ARGS__)
+#define LOG_ASYNC_KIND_1 FORMAT
+#define LOG_ASYNC_KIND_2 ARGS
+#define LOG_ASYNC_KIND_3 ARGS
+#define LOG_ASYNC_KIND_4 ARGS
+#define LOG_ASYNC_KIND_5 ARGS
+#define LOG_ASYNC_KIND_6 ARGS
+#define LOG_ASYNC_KIND_7 ARGS
+#define LOG_ASYNC_KIND_8 ARGS
+#define LOG_ASYNC_KIND_9 ARGS
+#define LOG_ASYNC_KIND_10 ARGS
+#define LOG_ASYNC_KIND_11 ARGS
+#define LOG_ASYNC_KIND_12 ARGS
+#define LOG_ASYNC_KIND_13 ARGS
+#define LOG_ASYNC_KIND_14 ARGS
+#define LOG_ASYNC_KIND_15 ARGS
+#define LOG_ASYNC_KIND_16 ARGS
+#define LOG_ASYNC_KIND_17 ARGS
+#define LOG_ASYNC_WRITE_FORMAT(format) log_async_write(format, 0, NULL)
+#define LOG_ASYNC_WRITE_ARGS(format, ...) \
+    log_async_write(format, LOG_ASYNC_COUNT(__VA_ARGS__), (log_arg_t[]){LOG_ASYNC_CAT(LOG_ASYNC_ARGS_, LOG_ASYNC_COUNT(__VA_ARGS__))(__VA_ARGS__)})
+
+/**
+ * @brief Records a message for the drain thread. Formats and writes it directly once the logger has been shut down at exit.
+ *
+ * @param format The printf format of the message, which must outlive the call.
+ * @param num_args The number of arguments, at most LOG_ASYNC_MAX_ARGS.
+ * @param args The arguments, see LOG_ARG.
+ */
+void log_async_write(const char *format, int num_args, const log_arg_t *args);
+
+/**
+ * @brief Waits until the messages recorded so far by the calling thread have been written, and flushes stdout.
+ */
+void log_async_flush(void);
+
+#endif // LOG_ASYNC_H
@@ -0,0 +1,39 @@
+/**
+ * @file mm_copy.h
+ * @brief Size tiered copy and zeroing of blocks, used by mm_realloc and the preloaded calloc.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Below the streaming threshold (MM_STREAM_THRESHOLD, by default half of the last level cache) these are memcpy and memset. Larger blocks are written with non-temporal (streaming) stores,
+ * so that moving a block bigger than the cache doesn't evict the caller's working set. The threshold and the AVX2 or SSE2 kernel are picked on the first large call,
+ * other CPUs and compilers use memcpy and memset.
+ */
+
+#ifndef MM_COPY_H
+#define MM_COPY_H
+
+#include <stddef.h>
+
+/**
+ * @brief Copies size bytes from src to dst, which must not overlap.
+ */
+void mm_copy(void *dst, const void *src, size_t size);
+
+/**
+ * @brief Sets size bytes at dst to zero.
+ */
+void mm_zero(void *dst, size_t size);
+
+/**
+ * @brief The size from which mm_copy and mm_zero use streaming stores.
+ */
+size_t mm_stream_threshold(void);
+
+/**
+ * @brief Overrides the streaming threshold, 0 puts back the default. Meant for benchmarks and tests, which compare the streamed and cached paths on the same sizes.
+ */
+void mm_set_stream_threshold(size_t threshold);
+
+#endif // MM_COPY_H
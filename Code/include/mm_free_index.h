@@ -0,0 +1,34 @@
+/**
+ * @file mm_free_index.h
+ * @brief Fit searches over the free block index of mm_lib, a contiguous array of 32 bit free block sizes.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The sizes are compared 8 at a time with AVX2 or 4 at a time with SSE4.1, picked on the first call like the kernels of mm_copy.h. Other CPUs and compilers use
+ * plain loops. Every search returns the position of the block in the array, or count if no block is large enough, and breaks ties by the lowest position.
+ */
+
+#ifndef MM_FREE_INDEX_H
+#define MM_FREE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Position of the first block of at least size bytes.
+ */
+size_t mm_index_first_fit(const uint32_t *sizes, size_t count, uint32_t size);
+
+/**
+ * @brief Position of the smallest block of at least size bytes.
+ */
+size_t mm_index_best_fit(const uint32_t *sizes, size_t count, uint32_t size);
+
+/**
+ * @brief Position of the largest block, if it has at least size bytes.
+ */
+size_t mm_index_worst_fit(const uint32_t *sizes, size_t count, uint32_t size);
+
+#endif // MM_FREE_INDEX_H
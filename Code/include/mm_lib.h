@@ -14,6 +14,58 @@
 
 #include <stddef.h>
 
+/**
+ * @brief Statistics collected by the allocator since the last call to `mm_init`.
+ * 
+ */
+typedef struct
+{
+    size_t malloc_calls;        // number of calls to mm_malloc
+    size_t free_calls;          // number of calls to mm_free
+    size_t realloc_calls;       // number of calls to mm_realloc
+    size_t memalign_calls;      // number of calls to mm_memalign
+
+    size_t bytes_allocated;     // total bytes handed out, including the alignment padding of each block
+    size_t bytes_freed;         // total bytes returned to the free list
+
+    size_t free_list_length;    // number of blocks currently in the free list and the fast bins
+    size_t largest_free_block;  // size of the largest block currently in the free list or the fast bins
+
+    size_t heap_extensions;     // number of times the heap was extended with sbrk
+    size_t splits;              // number of free blocks split to satisfy an allocation
+    size_t coalesces;           // number of times two adjacent free blocks were merged
+} mm_stats_t;
+
+// per call distributions of the work done inside mm_lib, only collected when it is built with MM_INSTRUMENT (see config.h). the nodes count the entries
+// of the free block index scanned by the searches, the steps of the binary search of free and the entries moved and merged by the coalescing pass of the fast bins
+#define LIST_OF_MM_PROBES                                                               \
+    X(malloc_nodes, "Malloc Nodes", "free index entries scanned per allocation")        \
+    X(malloc_retries, "Malloc Retries", "iterations of the search loop per allocation") \
+    X(malloc_sbrks, "Malloc Sbrks", "heap extensions per allocation")                   \
+    X(free_nodes, "Free Nodes", "free index entries compared per free")                 \
+    X(free_coalesces, "Free Coalesces", "coalesces per free")
+
+#define MM_PROBE_BUCKETS 16
+
+/**
+ * @brief Distribution of one probe over the calls recorded. Bucket 0 counts the calls with the value 0, bucket i > 0 the values from 2^(i-1) to 2^i - 1, the last bucket also every larger value.
+ * 
+ */
+typedef struct
+{
+    size_t calls;
+    size_t total;
+    size_t max;
+    size_t buckets[MM_PROBE_BUCKETS];
+} mm_probe_t;
+
+typedef struct
+{
+#define X(name, label, description) mm_probe_t name;
+    LIST_OF_MM_PROBES
+#undef X
+} mm_probes_t;
+
 /**
  * @brief Initializes the memory allocator, and the memory management system. All initialization of internal bookkeeping structures is done here. Note however, that the heap memory area is not initialized here. Heap memory initialization is done by the system. If needed, this can however call the sbrk function to get the initial heap memory.
  * 
@@ -21,7 +73,7 @@
 void mm_init (void);
 
 /**
- * @brief Allocates a block of memory of size `size` bytes. The allocated memory is aligned to 8 bytes. The allocated memory is not initialized.
+ * @brief Allocates a block of memory of size `size` bytes. The allocated memory is aligned to MM_ALIGNMENT bytes (see config.h, 8 by default and 16 in the preloaded build). The allocated memory is not initialized.
  * 
  * @param size The size of the memory block to be allocated.
  * @return void* Pointer to the first byte of the allocated memory block. Failure is indicated by NULL.
@@ -44,5 +96,45 @@ void mm_free (void* ptr);
  */
 void* mm_realloc (void* ptr, size_t size);
 
+/**
+ * @brief Allocates a block of memory of size `size` bytes whose address is a multiple of `alignment`. The returned block can be passed to `mm_free` and `mm_realloc` like any other block.
+ * 
+ * @param alignment The required alignment. Must be a power of two.
+ * @param size The size of the memory block to be allocated.
+ * @return void* Pointer to the first byte of the allocated memory block. Failure is indicated by NULL.
+ */
+void* mm_memalign (size_t alignment, size_t size);
+
+/**
+ * @brief Returns the number of bytes that can be used in the block pointed to by `ptr`, which is at least the size it was requested with.
+ * 
+ * @param ptr Pointer to a block returned by `mm_malloc`, `mm_realloc` or `mm_memalign`. If NULL, 0 is returned.
+ * @return size_t The usable size of the block.
+ */
+size_t mm_usable_size (void* ptr);
+
+/**
+ * @brief Returns the allocator statistics. The counters are cheap enough to be always on, the free list fields are computed by walking the free list at the time of the call.
+ * 
+ * @return mm_stats_t A snapshot of the allocator statistics.
+ */
+mm_stats_t mm_get_stats (void);
+
+/**
+ * @brief Copies the probes recorded since the last call to `mm_init` (see LIST_OF_MM_PROBES).
+ * 
+ * @param probes Filled with the probes.
+ * @return int 0 on success, -1 if mm_lib was built without MM_INSTRUMENT and there are no probes.
+ */
+int mm_get_probes (mm_probes_t* probes);
+
+/**
+ * @brief Walks the heap from `cm_heap_start()` to `cm_heap_end()` and writes one CSV record per block to `fd`, in the form `offset,size,state`. The offset is relative to the heap start, the size includes the block header and the state is `F` for free and `U` for used blocks.
+ * 
+ * @param fd The file descriptor to write the records to.
+ * @return int 0 on success, -1 if writing to `fd` failed.
+ */
+int mm_dump_heap_map (int fd);
+
 
 #endif // MM_LIB_H
\ No newline at end of file
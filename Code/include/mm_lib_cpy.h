@@ -0,0 +1,23 @@
+/**
+ * @file mm_lib_cpy.h
+ * @brief Alternative implementation of the memory management library, under its own names.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * src/mm_lib_cpy.c implements the allocation functions of mm_lib.h with an mm_cpy_ prefix, so that it can be linked next to mm_lib and compared with it by the test driver (see --backends).
+ * It only searches first fit, and mm_cpy_realloc always moves the block: it allocates the new size, copies the old content and frees the old block.
+ */
+
+#ifndef MM_LIB_CPY_H
+#define MM_LIB_CPY_H
+
+#include <stddef.h>
+
+void mm_cpy_init(void);
+void *mm_cpy_malloc(size_t size);
+void mm_cpy_free(void *ptr);
+void *mm_cpy_realloc(void *ptr, size_t size);
+
+#endif // MM_LIB_CPY_H
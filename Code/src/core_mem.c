@@ -3,6 +3,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <sys/mman.h>
 
 // STATIC GLOBALS TO KEEP TRACK OF MEMORY
 static char* memory_start      = NULL;
@@ -20,8 +21,11 @@ void cm_init_memory(void)
         exit(1);
     }
 
-    if (!(memory_start = (char*)malloc(MAX_HEAP_SIZE)))
+    // the arena is mapped directly instead of malloc'd, so that the allocator can also stand in for the libc malloc (see src/preload)
+    memory_start = (char*)mmap(NULL, MAX_HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory_start == MAP_FAILED)
     {
+        memory_start = NULL;
         LOG_ERROR("Failed to allocate memory from the system.\n");
         exit(1);
     }
@@ -38,7 +42,7 @@ void cm_free_memory (void)
     if (!memory_start)
         return;
     
-    free(memory_start);
+    munmap(memory_start, MAX_HEAP_SIZE);
     memory_start = NULL;
     memory_brk = NULL;
     memory_max_addr = NULL;
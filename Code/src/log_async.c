@@ -0,0 +1,350 @@
+#include "log_async.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// how long the drain thread sleeps when every ring is empty, unless a thread whose ring fills up wakes it
+#define DRAIN_INTERVAL_NS 1000000
+
+// a thread wakes the drain thread once its ring holds this many records
+#define WAKE_THRESHOLD (LOG_ASYNC_RING_RECORDS / 4)
+
+// the longest conversion specification that is passed on to printf, longer ones are written as they are
+#define MAX_SPEC_LENGTH 32
+
+typedef struct
+{
+    const char *format;
+    int num_args;
+    uint8_t types[LOG_ASYNC_MAX_ARGS];
+    log_value_t values[LOG_ASYNC_MAX_ARGS]; // strings are stored as their offset in strings, or -1 for NULL
+    char strings[LOG_ASYNC_STRING_BYTES + 1];
+} log_record_t;
+
+// single producer, single consumer ring. head is only written by the thread that owns the ring, tail only by the drain thread, both only ever grow
+typedef struct log_ring
+{
+    size_t head;
+    size_t tail;
+    int writing;           // set by the owner from before it checks stopping until its record is published, so that the shutdown waits for it
+    struct log_ring *next; // rings of all threads, pushed at the front and never removed
+    log_record_t records[LOG_ASYNC_RING_RECORDS];
+} log_ring_t;
+
+static log_ring_t *rings = NULL;
+static __thread log_ring_t *thread_ring = NULL;
+
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static pthread_t drain_thread;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static int drain_running = 0;
+static int stopping = 0;
+
+static long long signed_value(const log_record_t *record, int index)
+{
+    switch (record->types[index])
+    {
+    case LOG_ARG_UINT:
+        return (long long)record->values[index].u;
+    case LOG_ARG_DOUBLE:
+        return (long long)record->values[index].d;
+    default:
+        return record->values[index].i;
+    }
+}
+
+static double double_value(const log_record_t *record, int index)
+{
+    switch (record->types[index])
+    {
+    case LOG_ARG_INT:
+        return (double)record->values[index].i;
+    case LOG_ARG_UINT:
+        return (double)record->values[index].u;
+    case LOG_ARG_DOUBLE:
+        return record->values[index].d;
+    default:
+        return 0;
+    }
+}
+
+static const char *string_value(const log_record_t *record, int index)
+{
+    if (record->types[index] != LOG_ARG_STRING)
+        return "(invalid)";
+    return record->values[index].i < 0 ? "(null)" : record->strings + record->values[index].i;
+}
+
+// writes a record the way printf would have. every conversion is printed on its own with its length modifier replaced to fit the recorded value
+static void print_record(const log_record_t *record, FILE *out)
+{
+    const char *cursor = record->format;
+    int arg = 0;
+
+    while (*cursor != '\0')
+    {
+        const char *percent = strchr(cursor, '%');
+        if (percent == NULL)
+        {
+            fputs(cursor, out);
+            return;
+        }
+        fwrite(cursor, 1, percent - cursor, out);
+
+        // %[flags][width][.precision][length]conversion, a * width or precision is taken from the arguments and written into the specification
+        char spec[MAX_SPEC_LENGTH + 16];
+        size_t length = 0;
+        const char *end = percent + 1;
+        spec[length++] = '%';
+
+        while (*end != '\0' && strchr("-+ #0'", *end) != NULL && length < MAX_SPEC_LENGTH)
+            spec[length++] = *end++;
+        for (int part = 0; part < 2; part++)
+        {
+            if (part == 1)
+            {
+                if (*end != '.')
+                    break;
+                spec[length++] = *end++;
+            }
+            if (*end == '*' && length < MAX_SPEC_LENGTH)
+            {
+                end++;
+                int value = arg < record->num_args ? (int)signed_value(record, arg++) : 0;
+                length += snprintf(spec + length, sizeof(spec) - length, "%d", value);
+            }
+            while (*end >= '0' && *end <= '9' && length < MAX_SPEC_LENGTH)
+                spec[length++] = *end++;
+        }
+        while (*end != '\0' && strchr("hlLqjzt", *end) != NULL)
+            end++;
+
+        char conversion = *end;
+        if (conversion == '\0' || length >= MAX_SPEC_LENGTH)
+        {
+            fwrite(percent, 1, end - percent, out);
+            cursor = end;
+            continue;
+        }
+        cursor = end + 1;
+
+        if (conversion == '%')
+        {
+            fputc('%', out);
+            continue;
+        }
+        if (arg >= record->num_args || conversion == 'n')
+        {
+            fwrite(percent, 1, cursor - percent, out);
+            continue;
+        }
+
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            snprintf(spec + length, sizeof(spec) - length, "ll%c", conversion);
+            fprintf(out, spec, signed_value(record, arg));
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            snprintf(spec + length, sizeof(spec) - length, "ll%c", conversion);
+            fprintf(out, spec, (unsigned long long)signed_value(record, arg));
+            break;
+        case 'c':
+            snprintf(spec + length, sizeof(spec) - length, "c");
+            fprintf(out, spec, (int)signed_value(record, arg));
+            break;
+        case 's':
+            snprintf(spec + length, sizeof(spec) - length, "s");
+            fprintf(out, spec, string_value(record, arg));
+            break;
+        case 'p':
+            snprintf(spec + length, sizeof(spec) - length, "p");
+            fprintf(out, spec, record->values[arg].p);
+            break;
+        default:
+            snprintf(spec + length, sizeof(spec) - length, "%c", conversion);
+            fprintf(out, spec, double_value(record, arg));
+            break;
+        }
+        arg++;
+    }
+}
+
+// writes the published records of every ring, returns the number written
+static size_t drain_rings(void)
+{
+    size_t drained = 0;
+    for (log_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t tail = ring->tail;
+        for (; tail != head; tail++)
+        {
+            print_record(&ring->records[tail % LOG_ASYNC_RING_RECORDS], stdout);
+        }
+        drained += tail - ring->tail;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (drained > 0)
+        fflush(stdout);
+    return drained;
+}
+
+static void *drain(void *arg)
+{
+    (void)arg;
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+    {
+        if (drain_rings() > 0)
+            continue;
+
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += DRAIN_INTERVAL_NS;
+        if (until.tv_nsec >= 1000000000)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_timedwait(&wake, &wake_lock, &until);
+        pthread_mutex_unlock(&wake_lock);
+    }
+    return NULL;
+}
+
+// whether no thread is publishing a record and every published record has been written
+static int rings_idle(void)
+{
+    for (log_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+        if (__atomic_load_n(&ring->writing, __ATOMIC_SEQ_CST) || ring->tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+            return 0;
+    }
+    return 1;
+}
+
+// stops the drain thread and writes what is left. messages logged afterwards, by other exit handlers, are written directly
+// threads that checked stopping just before it was set still publish their records, so the rings are drained until they are idle
+static void shutdown_logger(void)
+{
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+    if (drain_running)
+        pthread_join(drain_thread, NULL);
+    drain_running = 0;
+
+    for (;;)
+    {
+        drain_rings();
+        if (rings_idle())
+            break;
+        sched_yield();
+    }
+}
+
+static void start_logger(void)
+{
+    drain_running = pthread_create(&drain_thread, NULL, drain, NULL) == 0;
+    atexit(shutdown_logger);
+}
+
+static log_ring_t *get_thread_ring(void)
+{
+    if (thread_ring == NULL)
+    {
+        log_ring_t *ring = calloc(1, sizeof(log_ring_t));
+        if (ring == NULL)
+            return NULL;
+
+        ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        thread_ring = ring;
+    }
+    return thread_ring;
+}
+
+static void fill_record(log_record_t *record, const char *format, int num_args, const log_arg_t *args)
+{
+    record->format = format;
+    record->num_args = num_args < LOG_ASYNC_MAX_ARGS ? num_args : LOG_ASYNC_MAX_ARGS;
+
+    size_t used = 0;
+    for (int i = 0; i < record->num_args; i++)
+    {
+        record->types[i] = (uint8_t)args[i].type;
+        record->values[i] = args[i].value;
+
+        if (args[i].type == LOG_ARG_STRING)
+        {
+            if (args[i].value.s == NULL)
+            {
+                record->values[i].i = -1;
+                continue;
+            }
+            // strings that don't fit anymore are cut short, down to the empty string at the very end
+            size_t length = strnlen(args[i].value.s, LOG_ASYNC_STRING_BYTES - used);
+            memcpy(record->strings + used, args[i].value.s, length);
+            record->strings[used + length] = '\0';
+            record->values[i].i = (long long)used;
+            used = used + length + 1 < LOG_ASYNC_STRING_BYTES ? used + length + 1 : LOG_ASYNC_STRING_BYTES;
+        }
+    }
+}
+
+void log_async_write(const char *format, int num_args, const log_arg_t *args)
+{
+    pthread_once(&start_once, start_logger);
+
+    log_ring_t *ring = get_thread_ring();
+    size_t head = ring != NULL ? ring->head : 0;
+    if (ring != NULL)
+        __atomic_store_n(&ring->writing, 1, __ATOMIC_SEQ_CST);
+
+    // a full ring waits for the drain thread to catch up
+    while (ring != NULL && drain_running && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE) &&
+           head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_ASYNC_RING_RECORDS)
+    {
+        pthread_cond_signal(&wake);
+        sched_yield();
+    }
+
+    if (ring == NULL || !drain_running || __atomic_load_n(&stopping, __ATOMIC_SEQ_CST))
+    {
+        if (ring != NULL)
+            __atomic_store_n(&ring->writing, 0, __ATOMIC_RELEASE);
+        log_record_t record;
+        fill_record(&record, format, num_args, args);
+        print_record(&record, stdout);
+        return;
+    }
+
+    fill_record(&ring->records[head % LOG_ASYNC_RING_RECORDS], format, num_args, args);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->writing, 0, __ATOMIC_RELEASE);
+
+    // the drain thread isn't woken for every message, only when the ring is filling up
+    if (head + 1 - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) == WAKE_THRESHOLD)
+        pthread_cond_signal(&wake);
+}
+
+void log_async_flush(void)
+{
+    log_ring_t *ring = thread_ring;
+    if (ring != NULL)
+    {
+        while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head && drain_running && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,232 @@
+#include "mm_copy.h"
+#include "utils.h"
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// streaming threshold when MM_STREAM_THRESHOLD is 0 and the size of the last level cache is unknown
+#define DEFAULT_STREAM_THRESHOLD (1 << 20)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MM_STREAM_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*copy_fn_t)(void *, const void *, size_t);
+typedef void (*zero_fn_t)(void *, size_t);
+
+static void copy_resolve(void *dst, const void *src, size_t size);
+static void zero_resolve(void *dst, size_t size);
+
+// the kernels for blocks of at least stream_threshold bytes, resolved on the first call above the initial threshold. every thread resolves to the same values, so racing on them is harmless
+static copy_fn_t copy_large = copy_resolve;
+static zero_fn_t zero_large = zero_resolve;
+static size_t stream_threshold = MM_STREAM_THRESHOLD ? MM_STREAM_THRESHOLD : DEFAULT_STREAM_THRESHOLD;
+
+static void copy_portable(void *dst, const void *src, size_t size)
+{
+    memcpy(dst, src, size);
+}
+
+static void zero_portable(void *dst, size_t size)
+{
+    memset(dst, 0, size);
+}
+
+#ifdef MM_STREAM_X86
+
+// the streaming stores need an aligned destination, the unaligned head and tail are written with plain stores. the head is at most the whole block, which
+// only happens below the size of one loop iteration with a threshold lowered by MM_STREAM_THRESHOLD or mm_set_stream_threshold
+// the sfence orders the weakly ordered streaming stores before anything the caller writes afterwards
+
+__attribute__((target("avx2"))) static void copy_avx2(void *dst, const void *src, size_t size)
+{
+    char *out = dst;
+    const char *in = src;
+
+    size_t head = MIN((32 - ((uintptr_t)out & 31)) & 31, size);
+    memcpy(out, in, head);
+    out += head;
+    in += head;
+    size -= head;
+
+    for (; size >= 128; size -= 128, out += 128, in += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)in);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(in + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(in + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(in + 96));
+        _mm256_stream_si256((__m256i *)out, a);
+        _mm256_stream_si256((__m256i *)(out + 32), b);
+        _mm256_stream_si256((__m256i *)(out + 64), c);
+        _mm256_stream_si256((__m256i *)(out + 96), d);
+    }
+    _mm_sfence();
+
+    memcpy(out, in, size);
+}
+
+__attribute__((target("avx2"))) static void zero_avx2(void *dst, size_t size)
+{
+    char *out = dst;
+
+    size_t head = MIN((32 - ((uintptr_t)out & 31)) & 31, size);
+    memset(out, 0, head);
+    out += head;
+    size -= head;
+
+    __m256i zero = _mm256_setzero_si256();
+    for (; size >= 128; size -= 128, out += 128)
+    {
+        _mm256_stream_si256((__m256i *)out, zero);
+        _mm256_stream_si256((__m256i *)(out + 32), zero);
+        _mm256_stream_si256((__m256i *)(out + 64), zero);
+        _mm256_stream_si256((__m256i *)(out + 96), zero);
+    }
+    _mm_sfence();
+
+    memset(out, 0, size);
+}
+
+__attribute__((target("sse2"))) static void copy_sse2(void *dst, const void *src, size_t size)
+{
+    char *out = dst;
+    const char *in = src;
+
+    size_t head = MIN((16 - ((uintptr_t)out & 15)) & 15, size);
+    memcpy(out, in, head);
+    out += head;
+    in += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, out += 64, in += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)in);
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(in + 48));
+        _mm_stream_si128((__m128i *)out, a);
+        _mm_stream_si128((__m128i *)(out + 16), b);
+        _mm_stream_si128((__m128i *)(out + 32), c);
+        _mm_stream_si128((__m128i *)(out + 48), d);
+    }
+    _mm_sfence();
+
+    memcpy(out, in, size);
+}
+
+__attribute__((target("sse2"))) static void zero_sse2(void *dst, size_t size)
+{
+    char *out = dst;
+
+    size_t head = MIN((16 - ((uintptr_t)out & 15)) & 15, size);
+    memset(out, 0, head);
+    out += head;
+    size -= head;
+
+    __m128i zero = _mm_setzero_si128();
+    for (; size >= 64; size -= 64, out += 64)
+    {
+        _mm_stream_si128((__m128i *)out, zero);
+        _mm_stream_si128((__m128i *)(out + 16), zero);
+        _mm_stream_si128((__m128i *)(out + 32), zero);
+        _mm_stream_si128((__m128i *)(out + 48), zero);
+    }
+    _mm_sfence();
+
+    memset(out, 0, size);
+}
+
+#endif // MM_STREAM_X86
+
+static size_t default_threshold(void)
+{
+    size_t threshold = MM_STREAM_THRESHOLD;
+    if (threshold == 0)
+    {
+        long llc_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc_size <= 0)
+            llc_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        threshold = llc_size > 0 ? (size_t)llc_size / 2 : DEFAULT_STREAM_THRESHOLD;
+    }
+    return threshold;
+}
+
+static void resolve_kernels(void)
+{
+    copy_fn_t copy = copy_portable;
+    zero_fn_t zero = zero_portable;
+    size_t threshold = default_threshold();
+
+#ifdef MM_STREAM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        copy = copy_avx2;
+        zero = zero_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        copy = copy_sse2;
+        zero = zero_sse2;
+    }
+#endif
+
+    __atomic_store_n(&stream_threshold, threshold, __ATOMIC_RELAXED);
+    __atomic_store_n(&copy_large, copy, __ATOMIC_RELAXED);
+    __atomic_store_n(&zero_large, zero, __ATOMIC_RELAXED);
+}
+
+// the threshold may have grown, so the call starts over
+static void copy_resolve(void *dst, const void *src, size_t size)
+{
+    resolve_kernels();
+    mm_copy(dst, src, size);
+}
+
+static void zero_resolve(void *dst, size_t size)
+{
+    resolve_kernels();
+    mm_zero(dst, size);
+}
+
+void mm_copy(void *dst, const void *src, size_t size)
+{
+    if (size < __atomic_load_n(&stream_threshold, __ATOMIC_RELAXED))
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+    __atomic_load_n(&copy_large, __ATOMIC_RELAXED)(dst, src, size);
+}
+
+void mm_zero(void *dst, size_t size)
+{
+    if (size < __atomic_load_n(&stream_threshold, __ATOMIC_RELAXED))
+    {
+        memset(dst, 0, size);
+        return;
+    }
+    __atomic_load_n(&zero_large, __ATOMIC_RELAXED)(dst, size);
+}
+
+size_t mm_stream_threshold(void)
+{
+    if (__atomic_load_n(&copy_large, __ATOMIC_RELAXED) == copy_resolve)
+    {
+        resolve_kernels();
+    }
+    return __atomic_load_n(&stream_threshold, __ATOMIC_RELAXED);
+}
+
+void mm_set_stream_threshold(size_t threshold)
+{
+    // resolved first, so that the first large call doesn't put the default back
+    if (__atomic_load_n(&copy_large, __ATOMIC_RELAXED) == copy_resolve)
+    {
+        resolve_kernels();
+    }
+    __atomic_store_n(&stream_threshold, threshold != 0 ? threshold : default_threshold(), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,309 @@
+#include "mm_free_index.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MM_INDEX_X86 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*fit_fn_t)(const uint32_t *, size_t, uint32_t);
+
+static size_t first_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size);
+static size_t best_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size);
+static size_t worst_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size);
+
+// the kernels, resolved on the first search. every thread resolves to the same values, so racing on them is harmless
+static fit_fn_t first_fit = first_fit_resolve;
+static fit_fn_t best_fit = best_fit_resolve;
+static fit_fn_t worst_fit = worst_fit_resolve;
+
+static size_t first_fit_portable(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sizes[i] >= size)
+            return i;
+    }
+    return count;
+}
+
+static size_t first_equal_portable(const uint32_t *sizes, size_t count, uint32_t value)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sizes[i] == value)
+            return i;
+    }
+    return count;
+}
+
+// an exact fit is the smallest block there can be, so the first one ends the search
+static size_t best_fit_portable(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    size_t best = count;
+    uint32_t best_size = UINT32_MAX;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sizes[i] >= size && sizes[i] < best_size)
+        {
+            best = i;
+            best_size = sizes[i];
+            if (best_size == size)
+                break;
+        }
+    }
+    return best;
+}
+
+static size_t worst_fit_portable(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    size_t worst = count;
+    uint32_t worst_size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sizes[i] > worst_size)
+        {
+            worst = i;
+            worst_size = sizes[i];
+        }
+    }
+    return worst_size >= size ? worst : count;
+}
+
+#ifdef MM_INDEX_X86
+
+// the sizes are unsigned, a lane fits when max(lane, size) is the lane itself. best and worst fit find the smallest fitting and the largest size in one pass,
+// then look for its first position. the lanes past the last full vector are left to the portable kernels
+
+__attribute__((target("avx2"))) static size_t first_equal_avx2(const uint32_t *sizes, size_t count, uint32_t value)
+{
+    __m256i wanted = _mm256_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i lanes = _mm256_loadu_si256((const __m256i *)(sizes + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, wanted)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_equal_portable(sizes + i, count - i, value);
+}
+
+__attribute__((target("avx2"))) static size_t first_fit_avx2(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m256i need = _mm256_set1_epi32((int)size);
+    size_t i = 0;
+
+    // 32 sizes per iteration, the position is only worked out in the group that has a fit
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(sizes + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(sizes + i + 8));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(sizes + i + 16));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(sizes + i + 24));
+        __m256i fits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(a, need), a), _mm256_cmpeq_epi32(_mm256_max_epu32(b, need), b)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(c, need), c), _mm256_cmpeq_epi32(_mm256_max_epu32(d, need), d)));
+        if (!_mm256_testz_si256(fits, fits))
+            break;
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i lanes = _mm256_loadu_si256((const __m256i *)(sizes + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_max_epu32(lanes, need), lanes)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_fit_portable(sizes + i, count - i, size);
+}
+
+__attribute__((target("avx2"))) static size_t best_fit_avx2(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m256i need = _mm256_set1_epi32((int)size);
+    __m256i ones = _mm256_set1_epi32(-1);
+    __m256i smallest = ones;
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i lanes = _mm256_loadu_si256((const __m256i *)(sizes + i));
+        int exact = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, need)));
+        if (exact != 0)
+            return i + __builtin_ctz(exact);
+
+        // lanes that don't fit are set to UINT32_MAX, which no block size is
+        __m256i fits = _mm256_cmpeq_epi32(_mm256_max_epu32(lanes, need), lanes);
+        smallest = _mm256_min_epu32(smallest, _mm256_or_si256(lanes, _mm256_andnot_si256(fits, ones)));
+    }
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, smallest);
+    uint32_t best_size = UINT32_MAX;
+    for (int lane = 0; lane < 8; lane++)
+        best_size = lanes[lane] < best_size ? lanes[lane] : best_size;
+
+    size_t tail = i + best_fit_portable(sizes + i, count - i, size);
+    if (tail < count && sizes[tail] < best_size)
+        return tail;
+    return best_size == UINT32_MAX ? count : first_equal_avx2(sizes, i, best_size);
+}
+
+__attribute__((target("avx2"))) static size_t worst_fit_avx2(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m256i largest = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        largest = _mm256_max_epu32(largest, _mm256_loadu_si256((const __m256i *)(sizes + i)));
+    }
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, largest);
+    uint32_t worst_size = 0;
+    for (int lane = 0; lane < 8; lane++)
+        worst_size = lanes[lane] > worst_size ? lanes[lane] : worst_size;
+
+    size_t tail = i + worst_fit_portable(sizes + i, count - i, 0);
+    if (tail < count && sizes[tail] > worst_size)
+        return sizes[tail] >= size ? tail : count;
+    return worst_size >= size && worst_size > 0 ? first_equal_avx2(sizes, i, worst_size) : count;
+}
+
+__attribute__((target("sse4.1"))) static size_t first_equal_sse41(const uint32_t *sizes, size_t count, uint32_t value)
+{
+    __m128i wanted = _mm_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i lanes = _mm_loadu_si128((const __m128i *)(sizes + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, wanted)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_equal_portable(sizes + i, count - i, value);
+}
+
+__attribute__((target("sse4.1"))) static size_t first_fit_sse41(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m128i need = _mm_set1_epi32((int)size);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i lanes = _mm_loadu_si128((const __m128i *)(sizes + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_max_epu32(lanes, need), lanes)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return i + first_fit_portable(sizes + i, count - i, size);
+}
+
+__attribute__((target("sse4.1"))) static size_t best_fit_sse41(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m128i need = _mm_set1_epi32((int)size);
+    __m128i ones = _mm_set1_epi32(-1);
+    __m128i smallest = ones;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i lanes = _mm_loadu_si128((const __m128i *)(sizes + i));
+        int exact = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, need)));
+        if (exact != 0)
+            return i + __builtin_ctz(exact);
+
+        __m128i fits = _mm_cmpeq_epi32(_mm_max_epu32(lanes, need), lanes);
+        smallest = _mm_min_epu32(smallest, _mm_or_si128(lanes, _mm_andnot_si128(fits, ones)));
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, smallest);
+    uint32_t best_size = UINT32_MAX;
+    for (int lane = 0; lane < 4; lane++)
+        best_size = lanes[lane] < best_size ? lanes[lane] : best_size;
+
+    size_t tail = i + best_fit_portable(sizes + i, count - i, size);
+    if (tail < count && sizes[tail] < best_size)
+        return tail;
+    return best_size == UINT32_MAX ? count : first_equal_sse41(sizes, i, best_size);
+}
+
+__attribute__((target("sse4.1"))) static size_t worst_fit_sse41(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    __m128i largest = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        largest = _mm_max_epu32(largest, _mm_loadu_si128((const __m128i *)(sizes + i)));
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, largest);
+    uint32_t worst_size = 0;
+    for (int lane = 0; lane < 4; lane++)
+        worst_size = lanes[lane] > worst_size ? lanes[lane] : worst_size;
+
+    size_t tail = i + worst_fit_portable(sizes + i, count - i, 0);
+    if (tail < count && sizes[tail] > worst_size)
+        return sizes[tail] >= size ? tail : count;
+    return worst_size >= size && worst_size > 0 ? first_equal_sse41(sizes, i, worst_size) : count;
+}
+
+#endif // MM_INDEX_X86
+
+static void resolve_kernels(void)
+{
+    fit_fn_t first = first_fit_portable;
+    fit_fn_t best = best_fit_portable;
+    fit_fn_t worst = worst_fit_portable;
+
+#ifdef MM_INDEX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        first = first_fit_avx2;
+        best = best_fit_avx2;
+        worst = worst_fit_avx2;
+    }
+    else if (__builtin_cpu_supports("sse4.1"))
+    {
+        first = first_fit_sse41;
+        best = best_fit_sse41;
+        worst = worst_fit_sse41;
+    }
+#endif
+
+    __atomic_store_n(&first_fit, first, __ATOMIC_RELAXED);
+    __atomic_store_n(&best_fit, best, __ATOMIC_RELAXED);
+    __atomic_store_n(&worst_fit, worst, __ATOMIC_RELAXED);
+}
+
+static size_t first_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    resolve_kernels();
+    return mm_index_first_fit(sizes, count, size);
+}
+
+static size_t best_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    resolve_kernels();
+    return mm_index_best_fit(sizes, count, size);
+}
+
+static size_t worst_fit_resolve(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    resolve_kernels();
+    return mm_index_worst_fit(sizes, count, size);
+}
+
+size_t mm_index_first_fit(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    return __atomic_load_n(&first_fit, __ATOMIC_RELAXED)(sizes, count, size);
+}
+
+size_t mm_index_best_fit(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    return __atomic_load_n(&best_fit, __ATOMIC_RELAXED)(sizes, count, size);
+}
+
+size_t mm_index_worst_fit(const uint32_t *sizes, size_t count, uint32_t size)
+{
+    return __atomic_load_n(&worst_fit, __ATOMIC_RELAXED)(sizes, count, size);
+}
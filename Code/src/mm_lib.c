@@ -1,13 +1,42 @@
 #include "core_mem.h"
 #include "mm_lib.h"
+#include "mm_copy.h"
+#include "mm_free_index.h"
+#include "mm_size_classes.h"
 #include "utils.h"
+#include "config.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 // -------- Macros defined for the allocator --------
 
+// search scheme used when the SEARCH_SCHEME environment variable is not set (e.g. when preloaded into an arbitrary program)
+#define DEFAULT_SEARCH_SCHEME "FIRST_FIT"
+
+// objects of at least this many bytes get cache lines of their own, 1 isolates every object. read by mm_init, unset or 0 turns it off
+#define LINE_ALIGN_ENV "MM_LINE_ALIGN"
+
+// values stored in header->magic1. An aligned header sits in front of a block returned by mm_memalign and stores the distance back to the real block in magic2.
+#define MAGIC_USED 0x55534544
+#define MAGIC_ALIGNED 0x414c4947
+
+// fast bin i holds the freed blocks of (i + 1) * MM_ALIGNMENT bytes, see MM_FASTBIN_MAX_SIZE
+#define NUM_FASTBINS (MM_FASTBIN_MAX_SIZE / MM_ALIGNMENT)
+
+// set in the size of a block that sits in a fast bin, sizes are multiples of MM_ALIGNMENT so the low bit is free. it tells fast bin blocks apart from used ones in a heap walk
+#define FAST_BIT 1
+
+// every free block holds at least a list_node and MM_ALIGNMENT bytes, so this many entries always hold the whole heap
+#define FREE_INDEX_ENTRIES (MAX_HEAP_SIZE / (sizeof(struct list_node) + MM_ALIGNMENT) + 1)
+
+// the offsets and sizes of the index are 32 bit
+_Static_assert(MAX_HEAP_SIZE <= (1ULL << 32), "the free block index needs a heap of at most 4GB");
+
 // --------- Definitions of the headers ---------
 struct list_node
 {
@@ -24,140 +53,254 @@ struct header
 
 // --------- Global Variables ---------
 
-struct list_node *list_node_head = NULL;
-
-// --------- Helper function declarations ---------
-
-void *search_for_free_block_first_fit(size_t aligned_size)
+// the free blocks, ordered by address, as two arrays: the offset of every block from the start of the heap and its size (the bytes after its list_node).
+// fits are searched in the sizes alone (see mm_free_index.h), so the memory of a free block is never read or written, only the header of the block handed out.
+// the arrays are mapped once with room for FREE_INDEX_ENTRIES, like the heap only the pages in use take memory
+static uint32_t *free_sizes = NULL;
+static uint32_t *free_offsets = NULL;
+static size_t free_count = 0;
+static char *heap_start = NULL;
+
+// fast bins, LIFO lists of small freed blocks linked through their list_node, and the bytes they hold. one spare bin so that the array isn't empty when they are disabled
+static struct list_node *fast_bins[NUM_FASTBINS + 1];
+static size_t fast_bin_bytes = 0;
+
+// placement mode, see LINE_ALIGN_ENV
+static size_t line_align_size = 0;
+
+// allocator statistics, reset by mm_init. These are plain counters so that they can be left on in release builds.
+static mm_stats_t stats;
+
+#if MM_INSTRUMENT
+// probes, reset by mm_init, and the counts of the call in progress that are recorded into them when it returns
+static mm_probes_t probes;
+static size_t call_nodes;
+static size_t call_retries;
+static size_t call_sbrks;
+static size_t call_coalesces;
+
+static void record_probe(mm_probe_t *probe, size_t value)
 {
-    struct list_node *search = list_node_head;
+    int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    probe->calls++;
+    probe->total += value;
+    probe->max = MAX(probe->max, value);
+    probe->buckets[MIN(bucket, MM_PROBE_BUCKETS - 1)]++;
+}
 
-    while (search != NULL && search->size < aligned_size)
+#define PROBE_BEGIN() (call_nodes = 0, call_retries = 0, call_sbrks = stats.heap_extensions, call_coalesces = stats.coalesces)
+#define PROBE_NODE() (call_nodes++)
+#define PROBE_NODES(count) (call_nodes += (count))
+#define PROBE_RETRY() (call_retries++)
+#define PROBE_END_MALLOC() (record_probe(&probes.malloc_nodes, call_nodes), record_probe(&probes.malloc_retries, call_retries), \
+                            record_probe(&probes.malloc_sbrks, stats.heap_extensions - call_sbrks))
+#define PROBE_END_FREE() (record_probe(&probes.free_nodes, call_nodes), record_probe(&probes.free_coalesces, stats.coalesces - call_coalesces))
+#else
+#define PROBE_BEGIN() ((void)0)
+#define PROBE_NODE() ((void)0)
+#define PROBE_NODES(count) ((void)0)
+#define PROBE_RETRY() ((void)0)
+#define PROBE_END_MALLOC() ((void)0)
+#define PROBE_END_FREE() ((void)0)
+#endif
+
+// --------- Free block index ---------
+
+// position in the heap of a block, and the block at a position
+#define OFFSET_OF(block) ((uint32_t)((char *)(block) - heap_start))
+#define BLOCK_AT(offset) ((void *)(heap_start + (offset)))
+
+// end of the free block at position i of the index, where a neighbour it can be coalesced with starts
+#define FREE_END(i) ((size_t)free_offsets[i] + sizeof(struct list_node) + free_sizes[i])
+
+static size_t index_position(uint32_t offset)
+{
+    size_t low = 0;
+    size_t high = free_count;
+    while (low < high)
     {
-        search = search->next;
+        PROBE_NODE();
+        size_t middle = low + (high - low) / 2;
+        if (free_offsets[middle] < offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
     }
-    return search;
+    return low;
+}
+
+static void index_insert(size_t position, uint32_t offset, uint32_t size)
+{
+    memmove(free_sizes + position + 1, free_sizes + position, (free_count - position) * sizeof(uint32_t));
+    memmove(free_offsets + position + 1, free_offsets + position, (free_count - position) * sizeof(uint32_t));
+    free_sizes[position] = size;
+    free_offsets[position] = offset;
+    free_count++;
+}
+
+static void index_remove(size_t position)
+{
+    memmove(free_sizes + position, free_sizes + position + 1, (free_count - position - 1) * sizeof(uint32_t));
+    memmove(free_offsets + position, free_offsets + position + 1, (free_count - position - 1) * sizeof(uint32_t));
+    free_count--;
 }
 
-void *search_for_previous_first_fit(size_t aligned_size)
+// coalesces the free block at position with the blocks right after and before it
+static void index_coalesce(size_t position)
 {
-    struct list_node *previous = NULL;
-    struct list_node *search = list_node_head;
-    while (search != NULL && search->size < aligned_size)
+    if (position + 1 < free_count && FREE_END(position) == free_offsets[position + 1])
     {
-        previous = search;
-        search = search->next;
+        free_sizes[position] += sizeof(struct list_node) + free_sizes[position + 1];
+        index_remove(position + 1);
+        stats.coalesces++;
     }
-    if (search == NULL)
+    if (position > 0 && FREE_END(position - 1) == free_offsets[position])
     {
-        previous = NULL;
+        free_sizes[position - 1] += sizeof(struct list_node) + free_sizes[position];
+        index_remove(position);
+        stats.coalesces++;
     }
-    return previous;
 }
 
-void *search_for_free_block_worst_fit(size_t aligned_size)
+static uint32_t *map_index_array(void)
 {
-    struct list_node *search = list_node_head;
-    size_t maximum_size = 0;
-    struct list_node *block_with_max_size = NULL;
+    void *array = mmap(NULL, FREE_INDEX_ENTRIES * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return array == MAP_FAILED ? NULL : array;
+}
+
+// merges two lists of free blocks ordered by descending address
+static struct list_node *merge_by_address(struct list_node *a, struct list_node *b)
+{
+    struct list_node merged;
+    struct list_node *tail = &merged;
 
-    while (search != NULL)
+    while (a != NULL && b != NULL)
     {
-        if (search->size >= aligned_size && search->size > maximum_size)
+        if (a > b)
+        {
+            tail->next = a;
+            a = a->next;
+        }
+        else
         {
-            block_with_max_size = search;
-            maximum_size = search->size;
+            tail->next = b;
+            b = b->next;
         }
-        search = search->next;
+        tail = tail->next;
     }
-    return block_with_max_size;
+    tail->next = a != NULL ? a : b;
+
+    return merged.next;
 }
 
-void *search_for_previous_worst_fit(size_t aligned_size)
+// merge sort of a list of free blocks by descending address
+static struct list_node *sort_by_address(struct list_node *list)
 {
-    struct list_node *previous = NULL;
-    struct list_node *previous_of_max = NULL;
-    struct list_node *search = list_node_head;
-    size_t maximum_size = 0;
-    struct list_node *block_with_max_size = NULL;
-
-    while (search != NULL)
+    if (list == NULL || list->next == NULL)
     {
-        if (search->size >= aligned_size && search->size > maximum_size)
-        {
-            previous_of_max = previous;
-            block_with_max_size = search;
-            maximum_size = search->size;
-        }
-        previous = search;
-        search = search->next;
+        return list;
     }
-    if (block_with_max_size == NULL)
+
+    struct list_node *slow = list;
+    struct list_node *fast = list->next;
+    while (fast != NULL && fast->next != NULL)
     {
+        slow = slow->next;
+        fast = fast->next->next;
     }
-    return previous_of_max;
+    struct list_node *second_half = slow->next;
+    slow->next = NULL;
+
+    return merge_by_address(sort_by_address(list), sort_by_address(second_half));
 }
 
-void *search_for_free_block_best_fit(size_t aligned_size)
+// moves every fast bin block into the index in one batch. the blocks are sorted by address and merged into the index from its end, moving every entry at most once,
+// then neighbours are coalesced in a single pass
+static void consolidate_fast_bins(void)
 {
-    struct list_node *search = list_node_head;
-    size_t minimum_size = 100000000000000000;
-    struct list_node *block_with_min_size = NULL;
-
-    while (search != NULL)
+    struct list_node *blocks = NULL;
+    size_t num_blocks = 0;
+    for (int i = 0; i < NUM_FASTBINS; i++)
     {
-        if (search->size >= aligned_size && search->size < minimum_size)
+        while (fast_bins[i] != NULL)
         {
-            block_with_min_size = search;
-            minimum_size = search->size;
+            struct list_node *node = fast_bins[i];
+            fast_bins[i] = node->next;
+            node->size &= ~(size_t)FAST_BIT;
+            node->next = blocks;
+            blocks = node;
+            num_blocks++;
         }
-        search = search->next;
     }
-    return block_with_min_size;
-}
-
-void *search_for_previous_best_fit(size_t aligned_size)
-{
-    struct list_node *previous = NULL;
-    struct list_node *previous_of_min = NULL;
-    struct list_node *search = list_node_head;
-    size_t minimum_size = 100000000000000000;
-    struct list_node *block_with_min_size = NULL;
+    fast_bin_bytes = 0;
 
-    while (search != NULL)
+    size_t read = free_count;
+    size_t write = free_count + num_blocks;
+    for (struct list_node *node = sort_by_address(blocks); node != NULL; node = node->next)
     {
-        if (search->size >= aligned_size && search->size < minimum_size)
+        uint32_t offset = OFFSET_OF(node);
+        while (read > 0 && free_offsets[read - 1] > offset)
         {
-            previous_of_min = previous;
-            block_with_min_size = search;
-            minimum_size = search->size;
+            PROBE_NODE();
+            read--;
+            write--;
+            free_offsets[write] = free_offsets[read];
+            free_sizes[write] = free_sizes[read];
         }
-        previous = search;
-        search = search->next;
+        write--;
+        free_offsets[write] = offset;
+        free_sizes[write] = (uint32_t)node->size;
     }
-    if (block_with_min_size == NULL)
+    free_count += num_blocks;
+
+    size_t kept = 0;
+    for (size_t i = 1; i < free_count; i++)
     {
+        PROBE_NODE();
+        if (FREE_END(kept) == free_offsets[i])
+        {
+            free_sizes[kept] += sizeof(struct list_node) + free_sizes[i];
+            stats.coalesces++;
+        }
+        else
+        {
+            kept++;
+            free_offsets[kept] = free_offsets[i];
+            free_sizes[kept] = free_sizes[i];
+        }
     }
-    return previous_of_min;
+    free_count = free_count > 0 ? kept + 1 : 0;
 }
 
-void *search_for_list_tail()
+// --------- Function Definitions ---------
+void mm_init()
 {
-    struct list_node *search2 = list_node_head;
-    if (list_node_head == NULL)
+    memset(&stats, 0, sizeof(stats));
+#if MM_INSTRUMENT
+    memset(&probes, 0, sizeof(probes));
+#endif
+    memset(fast_bins, 0, sizeof(fast_bins));
+    fast_bin_bytes = 0;
+
+    char *line_align = getenv(LINE_ALIGN_ENV);
+    line_align_size = line_align != NULL ? strtoull(line_align, NULL, 10) : 0;
+
+    free_count = 0;
+    if (free_sizes == NULL)
     {
-        return search2;
+        free_sizes = map_index_array();
+        free_offsets = map_index_array();
     }
-    while (search2->next != NULL)
+    if (free_sizes == NULL || free_offsets == NULL)
     {
-        search2 = search2->next;
+        return;
     }
-    return search2;
-}
+    heap_start = cm_heap_start();
 
-// --------- Function Definitions ---------
-void mm_init()
-{
     void *start_heap = NULL;
     size_t heap_size = 1024;
     start_heap = cm_sbrk(heap_size);
@@ -166,53 +309,94 @@ void mm_init()
     {
         return;
     }
-    struct list_node *first_node = start_heap;
-    first_node->size = heap_size - sizeof(struct list_node);
-    first_node->next = NULL;
-    list_node_head = first_node;
+    index_insert(0, OFFSET_OF(start_heap), heap_size - sizeof(struct list_node));
 }
 
-void *mm_malloc(size_t size)
+static void *allocate_block(size_t size)
 {
+    // requests that can never fit would otherwise keep extending the heap until sbrk fails
+    if (size > MAX_HEAP_SIZE - sizeof(struct header) || free_sizes == NULL)
+    {
+        return NULL;
+    }
 
-    char *search_scheme = getenv("SEARCH_SCHEME");
+    PROBE_BEGIN();
 
     int allocation_found = 0;
     size_t aligned_size = size;
-    while (aligned_size % 8 != 0)
+    while (aligned_size % MM_ALIGNMENT != 0)
     {
         aligned_size = aligned_size + 1;
     }
     if (size == 0)
     {
-        aligned_size = 8; // minimum 8
+        aligned_size = MM_ALIGNMENT; // minimum MM_ALIGNMENT
+    }
+#if MM_SIZE_CLASSES
+    // the classes are multiples of MM_SIZE_CLASS_GRANULE, which is finer than MM_ALIGNMENT in the preloaded build
+    if (aligned_size <= MM_SIZE_CLASS_MAX_SIZE)
+    {
+        aligned_size = (mm_size_class_round(aligned_size) + MM_ALIGNMENT - 1) & ~(size_t)(MM_ALIGNMENT - 1);
+    }
+#endif
+
+#if MM_FASTBIN_MAX_SIZE > 0
+    // a block of exactly this size freed recently is handed out again without searching
+    if (aligned_size <= MM_FASTBIN_MAX_SIZE && fast_bins[aligned_size / MM_ALIGNMENT - 1] != NULL)
+    {
+        struct list_node *fast_node = fast_bins[aligned_size / MM_ALIGNMENT - 1];
+        fast_bins[aligned_size / MM_ALIGNMENT - 1] = fast_node->next;
+        fast_bin_bytes -= aligned_size;
+
+        struct header *header = (struct header *)fast_node;
+        header->size = aligned_size;
+        header->magic1 = MAGIC_USED;
+        header->magic2 = 0;
+        stats.bytes_allocated += aligned_size;
+
+        PROBE_END_MALLOC();
+        return PTR_ADD(header, sizeof(struct header));
+    }
+#endif
+
+    char *search_scheme = getenv("SEARCH_SCHEME");
+    if (search_scheme == NULL)
+    {
+        search_scheme = DEFAULT_SEARCH_SCHEME;
     }
 
-    struct list_node *returned_node = NULL;
-    struct list_node *previous_node = NULL;
     void *return_malloc = NULL;
     while (allocation_found != 1)
     {
+        PROBE_RETRY();
 
+        size_t position = free_count;
         if (strcmp(search_scheme, "FIRST_FIT") == 0)
         {
-            returned_node = search_for_free_block_first_fit(aligned_size);
-            previous_node = search_for_previous_first_fit(aligned_size);
+            position = mm_index_first_fit(free_sizes, free_count, (uint32_t)aligned_size);
+            PROBE_NODES(MIN(position + 1, free_count));
         }
 
         else if (strcmp(search_scheme, "WORST_FIT") == 0)
         {
-            returned_node = search_for_free_block_worst_fit(aligned_size);
-            previous_node = search_for_previous_worst_fit(aligned_size);
+            position = mm_index_worst_fit(free_sizes, free_count, (uint32_t)aligned_size);
+            PROBE_NODES(free_count);
         }
 
         else if (strcmp(search_scheme, "BEST_FIT") == 0)
         {
-            returned_node = search_for_free_block_best_fit(aligned_size);
-            previous_node = search_for_previous_best_fit(aligned_size);
+            position = mm_index_best_fit(free_sizes, free_count, (uint32_t)aligned_size);
+            PROBE_NODES(free_count);
         }
 
-        if (returned_node == NULL)
+        // the fast bins may hold neighbours that together fit, they are only merged into the index before the heap is grown
+        if (position == free_count && fast_bin_bytes > 0)
+        {
+            consolidate_fast_bins();
+            continue;
+        }
+
+        if (position == free_count)
         {
             size_t heap_size = 1024;
             void* heap_new = cm_sbrk(heap_size);
@@ -220,181 +404,295 @@ void *mm_malloc(size_t size)
             {
                 return NULL;
             }
-            struct list_node *extended_heap_node = (struct list_node *)heap_new;
-            extended_heap_node->next = NULL;
-            extended_heap_node->size = heap_size - sizeof(struct list_node);
-            if (list_node_head == NULL)
+            stats.heap_extensions++;
+
+            // the new memory is added to the last free block when that one ends the heap
+            uint32_t offset = OFFSET_OF(heap_new);
+            if (free_count > 0 && FREE_END(free_count - 1) == offset)
             {
-                list_node_head = extended_heap_node;
+                free_sizes[free_count - 1] += heap_size;
+                stats.coalesces++;
             }
             else
             {
-                struct list_node *tail = search_for_list_tail();
-                if (tail != NULL)
-                {
-                    tail->next = extended_heap_node;
-                    size_t size_of_tail_node_and_its_holding = sizeof(struct list_node) + tail->size; // coalescing
-                    struct list_node *check_if_coalesce = PTR_ADD(tail, size_of_tail_node_and_its_holding);
-                    if (check_if_coalesce == extended_heap_node)
-                    {
-                        tail->size = tail->size + sizeof(struct list_node) + extended_heap_node->size;
-                        tail->next = extended_heap_node->next;
-                        extended_heap_node = NULL;
-                    }
-                }
+                index_insert(free_count, offset, heap_size - sizeof(struct list_node));
             }
 
             continue;
         }
         allocation_found = 1;
 
-        struct list_node *next_of_returned_node = returned_node->next;
-        size_t size_of_retunred_node = returned_node->size;
-        struct list_node *stored_returned_node = returned_node;
+        size_t size_of_returned_node = free_sizes[position];
 
-        struct header *header = (struct header *)returned_node;
+        struct header *header = (struct header *)BLOCK_AT(free_offsets[position]);
         header->size = aligned_size;
+        header->magic1 = MAGIC_USED;
+        header->magic2 = 0;
+        stats.bytes_allocated += aligned_size;
 
-        size_t remaining_size = size_of_retunred_node - aligned_size;
+        size_t remaining_size = size_of_returned_node - aligned_size;
 
         if (remaining_size > sizeof(struct list_node))
         {
-            size_t combined_size = aligned_size + sizeof(struct header);
-            struct list_node *new_list_node = (struct list_node *)PTR_ADD(header, combined_size);
-            new_list_node->size = remaining_size - sizeof(struct list_node);
-            new_list_node->next = next_of_returned_node;
-
-            if (stored_returned_node == list_node_head)
-            {
-                list_node_head = new_list_node;
-            }
-            else
-            {
-                previous_node->next = new_list_node;
-            }
+            // the rest of the block keeps its place in the index, it still lies between the same neighbours
+            free_offsets[position] += sizeof(struct header) + aligned_size;
+            free_sizes[position] = remaining_size - sizeof(struct list_node);
+            stats.splits++;
         }
         else
         {
-            if (stored_returned_node == list_node_head)
-            {
-                list_node_head = next_of_returned_node;
-            }
-            else
-            {
-                previous_node->next = next_of_returned_node;
-            }
+            // the leftover is too small to become a free block. it is handed out with this block instead of being lost, which also keeps the heap walkable block by block
+            header->size = size_of_returned_node;
+            stats.bytes_allocated += remaining_size;
+            index_remove(position);
         }
         return_malloc = PTR_ADD(header, sizeof(struct header));
     }
+    PROBE_END_MALLOC();
     return return_malloc;
 }
 
-void mm_free(void *ptr)
+static void release_block(void *ptr)
 {
     if (ptr == NULL)
     {
         return;
     }
+    PROBE_BEGIN();
+
     struct header *header_of_free = (struct header *)PTR_SUB(ptr, sizeof(struct header));
-    struct list_node *new_list_node_after_free = (struct list_node *)header_of_free;
-    new_list_node_after_free->size = header_of_free->size;
-    new_list_node_after_free->next = NULL;
+    if (header_of_free->magic1 == MAGIC_ALIGNED)
+    {
+        // block came from mm_memalign, free the underlying block instead
+        ptr = PTR_SUB(ptr, header_of_free->magic2);
+        header_of_free = (struct header *)PTR_SUB(ptr, sizeof(struct header));
+    }
+    stats.bytes_freed += header_of_free->size;
+
+    size_t freed_size = header_of_free->size;
 
-    struct list_node *node_greater_than = list_node_head;
-    struct list_node *previous_of_node_greater_than = NULL;
-    while (node_greater_than != NULL)
+#if MM_FASTBIN_MAX_SIZE > 0
+    // small blocks are put in their fast bin as they are, to be coalesced later in a batch
+    if (freed_size <= MM_FASTBIN_MAX_SIZE && freed_size % MM_ALIGNMENT == 0)
     {
-        if (node_greater_than < new_list_node_after_free)
-        {
-            previous_of_node_greater_than = node_greater_than;
-            node_greater_than = node_greater_than->next;
-            continue;
-        }
-        else
+        struct list_node *fast_node = (struct list_node *)header_of_free;
+        fast_node->size = freed_size | FAST_BIT;
+        fast_node->next = fast_bins[freed_size / MM_ALIGNMENT - 1];
+        fast_bins[freed_size / MM_ALIGNMENT - 1] = fast_node;
+        fast_bin_bytes += freed_size;
+
+        if (fast_bin_bytes > MM_FASTBIN_MAX_BYTES)
         {
-            break;
+            consolidate_fast_bins();
         }
+        PROBE_END_FREE();
+        return;
     }
+#endif
+
+    uint32_t offset = OFFSET_OF(header_of_free);
+    size_t position = index_position(offset);
+    index_insert(position, offset, (uint32_t)freed_size);
+    index_coalesce(position);
+    PROBE_END_FREE();
+}
 
-    if (node_greater_than == list_node_head)
+static void *allocate_aligned_block(size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || size > MAX_HEAP_SIZE)
     {
-        new_list_node_after_free->next = list_node_head;
-        list_node_head = new_list_node_after_free;
+        return NULL;
     }
-    else
+    if (alignment <= MM_ALIGNMENT)
     {
-        new_list_node_after_free->next = previous_of_node_greater_than->next;
-        previous_of_node_greater_than->next = new_list_node_after_free;
+        return allocate_block(size);
     }
 
-    // coalescing
-    struct list_node *search = list_node_head;
-    struct list_node *prev = NULL;
-    while (search != NULL)
+    // over allocate so that there is always room for an aligned header in front of the aligned address
+    void *block = allocate_block(size + alignment + sizeof(struct header));
+    if (block == NULL)
     {
-        if (search == new_list_node_after_free)
-        {
-            break;
-        }
-        prev = search;
-        search = search->next;
+        return NULL;
     }
-    if (new_list_node_after_free->next != NULL)
+
+    uintptr_t aligned = ((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned == (uintptr_t)block)
     {
-        size_t size_of_new_node_combined = sizeof(struct list_node) + new_list_node_after_free->size;
-        struct list_node *next_node_of_new = PTR_ADD(new_list_node_after_free, size_of_new_node_combined);
-        if (next_node_of_new == new_list_node_after_free->next)
-        {
-            new_list_node_after_free->size = new_list_node_after_free->size + sizeof(struct list_node) + new_list_node_after_free->next->size;
-            new_list_node_after_free->next = new_list_node_after_free->next->next;
-            next_node_of_new = NULL;
-        }
+        return block;
     }
-
-    if (prev != NULL)
+    if (aligned - (uintptr_t)block < sizeof(struct header))
     {
-        size_t size_of_prev_node_combined = sizeof(struct list_node) + prev->size;
-        struct list_node *next_node_of_prev = PTR_ADD(prev, size_of_prev_node_combined);
+        aligned += alignment;
+    }
 
-        if (new_list_node_after_free == next_node_of_prev)
-        {
-            prev->size = prev->size + sizeof(struct list_node) + new_list_node_after_free->size;
-            prev->next = new_list_node_after_free->next;
-            new_list_node_after_free = NULL;
-        }
+    struct header *block_header = (struct header *)PTR_SUB(block, sizeof(struct header));
+    struct header *aligned_header = (struct header *)PTR_SUB(aligned, sizeof(struct header));
+    int offset = (int)(aligned - (uintptr_t)block);
+    aligned_header->size = block_header->size - offset;
+    aligned_header->magic1 = MAGIC_ALIGNED;
+    aligned_header->magic2 = offset;
+
+    return (void *)aligned;
+}
+
+// allocates a block with the placement in effect. with MM_LINE_ALIGN set, objects of at least line_align_size bytes start on a cache line and are
+// rounded up to whole lines, so no other object (of this or any other thread) shares their lines. with 1 every object is placed so, the line in front
+// of one then only holds headers, which are written by malloc and free but not while the object is in use
+static void *place_block(size_t size)
+{
+    if (line_align_size != 0 && size >= line_align_size && size <= MAX_HEAP_SIZE)
+    {
+        size_t lines_size = (size + MM_CACHE_LINE_SIZE - 1) & ~(size_t)(MM_CACHE_LINE_SIZE - 1);
+        return allocate_aligned_block(MM_CACHE_LINE_SIZE, lines_size);
     }
+    return allocate_block(size);
+}
+
+void *mm_malloc(size_t size)
+{
+    stats.malloc_calls++;
+    return place_block(size);
+}
+
+void mm_free(void *ptr)
+{
+    stats.free_calls++;
+    release_block(ptr);
 }
 
 void *mm_realloc(void *ptr, size_t size)
 {
+    stats.realloc_calls++;
+
     if (ptr == NULL)
     {
-        void *allocated = mm_malloc(size);
+        void *allocated = place_block(size);
         return allocated;
     }
     if (size == 0)
     {
-        mm_free(ptr);
+        release_block(ptr);
         return NULL;
     }
 
-    void *ptr_of_new_allocation = mm_malloc(size);
+    void *ptr_of_new_allocation = place_block(size);
+    if (ptr_of_new_allocation == NULL)
+    {
+        return NULL;
+    }
 
     struct header *header_of_realloc = (struct header *)PTR_SUB(ptr, sizeof(struct header));
     if (size < header_of_realloc->size)
     {
         size_t content_to_copy = size;
 
-        memcpy(ptr_of_new_allocation, ptr, content_to_copy);
-        mm_free(ptr);
+        mm_copy(ptr_of_new_allocation, ptr, content_to_copy);
+        release_block(ptr);
     }
     else
     {
         size_t content_to_copy = header_of_realloc->size;
 
-        memcpy(ptr_of_new_allocation, ptr, content_to_copy);
-        mm_free(ptr);
+        mm_copy(ptr_of_new_allocation, ptr, content_to_copy);
+        release_block(ptr);
     }
 
     return ptr_of_new_allocation;
 }
+
+void *mm_memalign(size_t alignment, size_t size)
+{
+    stats.memalign_calls++;
+    return allocate_aligned_block(alignment, size);
+}
+
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return 0;
+    }
+    struct header *header = (struct header *)PTR_SUB(ptr, sizeof(struct header));
+    return header->size;
+}
+
+mm_stats_t mm_get_stats(void)
+{
+    mm_stats_t current = stats;
+
+    // the index is only walked here, keeping the allocation paths free of any extra bookkeeping. fast bin blocks count as free blocks
+    for (size_t i = 0; i < free_count; i++)
+    {
+        current.free_list_length++;
+        current.largest_free_block = MAX(current.largest_free_block, (size_t)free_sizes[i]);
+    }
+    for (int i = 0; i < NUM_FASTBINS; i++)
+    {
+        for (struct list_node *node = fast_bins[i]; node != NULL; node = node->next)
+        {
+            current.free_list_length++;
+            current.largest_free_block = MAX(current.largest_free_block, (size_t)(i + 1) * MM_ALIGNMENT);
+        }
+    }
+
+    return current;
+}
+
+int mm_get_probes(mm_probes_t *out)
+{
+#if MM_INSTRUMENT
+    *out = probes;
+    return 0;
+#else
+    (void)out;
+    return -1;
+#endif
+}
+
+int mm_dump_heap_map(int fd)
+{
+    char buffer[4096];
+    size_t used = 0;
+
+    char *block = cm_heap_start();
+    char *heap_end = cm_heap_end();
+    size_t next_free = 0;
+
+    // the heap is tiled with blocks, each starting with either a list_node (free) or a header (in use). the index is address ordered, so it is walked alongside the heap to tell the two apart.
+    // blocks in the fast bins look like used blocks, apart from the FAST_BIT in their size
+    while (block != NULL && block < heap_end)
+    {
+        size_t block_size;
+        int is_free = next_free < free_count && block == (char *)BLOCK_AT(free_offsets[next_free]);
+
+        if (is_free)
+        {
+            block_size = sizeof(struct list_node) + free_sizes[next_free];
+            next_free++;
+        }
+        else
+        {
+            size_t size = ((struct header *)block)->size;
+            is_free = (size & FAST_BIT) != 0;
+            block_size = sizeof(struct header) + (size & ~(size_t)FAST_BIT);
+        }
+
+        if (sizeof(buffer) - used < 64)
+        {
+            if (write(fd, buffer, used) != (ssize_t)used)
+            {
+                return -1;
+            }
+            used = 0;
+        }
+        used += snprintf(buffer + used, sizeof(buffer) - used, "%zu,%zu,%c\n", (size_t)(block - (char *)cm_heap_start()), block_size, is_free ? 'F' : 'U');
+
+        block += block_size;
+    }
+
+    if (used > 0 && write(fd, buffer, used) != (ssize_t)used)
+    {
+        return -1;
+    }
+    return 0;
+}
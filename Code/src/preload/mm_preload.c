@@ -0,0 +1,334 @@
+/**
+ * @file mm_preload.c
+ * @brief Interposition layer that exports the standard malloc family on top of mm_lib, so that the allocator can be loaded into any dynamically linked program with LD_PRELOAD.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Usage: LD_PRELOAD=build/libmm_malloc.so SEARCH_SCHEME=BEST_FIT python3 -c 'print(1)'
+ *
+ * Pointers that were not handed out by mm_lib (allocations done by the libc malloc before the library was loaded, or when the arena is exhausted) are forwarded to the next malloc implementation, which is looked up with dlsym. dlsym itself may allocate, so any allocation made while the lookup is in progress is served from a small static bootstrap buffer that is never freed.
+ */
+
+#define _GNU_SOURCE
+
+#include "core_mem.h"
+#include "mm_lib.h"
+#include "mm_copy.h"
+#include "utils.h"
+#include "config.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// size of the static buffer used for allocations made while bootstrapping
+#define BOOTSTRAP_BUFFER_SIZE (64 * 1024)
+
+// the next malloc implementation in the lookup chain (normally libc)
+typedef void *(*libc_malloc_fn_t)(size_t);
+typedef void (*libc_free_fn_t)(void *);
+typedef void *(*libc_realloc_fn_t)(void *, size_t);
+typedef size_t (*libc_usable_size_fn_t)(void *);
+
+static libc_malloc_fn_t libc_malloc = NULL;
+static libc_free_fn_t libc_free = NULL;
+static libc_realloc_fn_t libc_realloc = NULL;
+static libc_usable_size_fn_t libc_usable_size = NULL;
+
+// 0 = not initialized, 1 = initialization in progress, 2 = ready
+static volatile int init_state = 0;
+
+// mm_lib is not thread safe, all calls into it are serialized by this lock
+static volatile char allocator_lock = 0;
+
+// set while the current thread is inside the allocator. a nested call (e.g. from dlsym, or from a LOG_ERROR that ends up in printf) is served from the bootstrap buffer instead of deadlocking
+static __thread int in_allocator __attribute__((tls_model("initial-exec"))) = 0;
+
+// bump allocator for bootstrap allocations. every block is prefixed with its size so that realloc can copy it out.
+static char bootstrap_buffer[BOOTSTRAP_BUFFER_SIZE] __attribute__((aligned(MM_ALIGNMENT)));
+static size_t bootstrap_used = 0;
+
+// --------- Helper functions ---------
+
+static void lock(void)
+{
+    // the holder may be waiting for the CPU this thread is spinning on, so the waiter gives it up
+    while (__atomic_test_and_set(&allocator_lock, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+}
+
+static void unlock(void)
+{
+    __atomic_clear(&allocator_lock, __ATOMIC_RELEASE);
+}
+
+// fork handlers. the lock is held across fork, so that the child never starts with a lock taken by a thread that doesn't exist there, or with mm_lib halfway through a call
+static void before_fork(void)
+{
+    lock();
+}
+
+static void after_fork(void)
+{
+    unlock();
+}
+
+static void *bootstrap_alloc(size_t size)
+{
+    size_t total = MM_ALIGNMENT + ((size + MM_ALIGNMENT - 1) & ~(size_t)(MM_ALIGNMENT - 1));
+    size_t offset = __atomic_fetch_add(&bootstrap_used, total, __ATOMIC_RELAXED);
+
+    if (offset + total > BOOTSTRAP_BUFFER_SIZE)
+    {
+        return NULL;
+    }
+
+    *(size_t *)(bootstrap_buffer + offset) = size;
+    return bootstrap_buffer + offset + MM_ALIGNMENT;
+}
+
+static int is_bootstrap(void *ptr)
+{
+    return (char *)ptr >= bootstrap_buffer && (char *)ptr < bootstrap_buffer + BOOTSTRAP_BUFFER_SIZE;
+}
+
+static size_t bootstrap_size(void *ptr)
+{
+    return *(size_t *)PTR_SUB(ptr, MM_ALIGNMENT);
+}
+
+static int is_managed(void *ptr)
+{
+    return (char *)ptr >= (char *)cm_heap_start() && (char *)ptr < (char *)cm_heap_end();
+}
+
+static void init(void)
+{
+    if (__atomic_load_n(&init_state, __ATOMIC_ACQUIRE) == 2)
+    {
+        return;
+    }
+
+    lock();
+    if (init_state == 0)
+    {
+        init_state = 1;
+
+        // resolve the fallback allocator. dlsym may call back into malloc/calloc, which lands in the bootstrap buffer because in_allocator is set
+        in_allocator = 1;
+        libc_malloc = (libc_malloc_fn_t)dlsym(RTLD_NEXT, "malloc");
+        libc_free = (libc_free_fn_t)dlsym(RTLD_NEXT, "free");
+        libc_realloc = (libc_realloc_fn_t)dlsym(RTLD_NEXT, "realloc");
+        libc_usable_size = (libc_usable_size_fn_t)dlsym(RTLD_NEXT, "malloc_usable_size");
+
+        cm_init_memory();
+        mm_init();
+        pthread_atfork(before_fork, after_fork, after_fork);
+        in_allocator = 0;
+
+        __atomic_store_n(&init_state, 2, __ATOMIC_RELEASE);
+    }
+    unlock();
+}
+
+// enters the allocator. returns 0 if the call is nested and has to be served from the bootstrap buffer
+static int enter(void)
+{
+    if (in_allocator)
+    {
+        return 0;
+    }
+
+    init();
+    lock();
+    in_allocator = 1;
+    return 1;
+}
+
+static void leave(void)
+{
+    in_allocator = 0;
+    unlock();
+}
+
+static void *alloc_aligned(size_t alignment, size_t size)
+{
+    if (!enter())
+    {
+        return alignment <= MM_ALIGNMENT ? bootstrap_alloc(size) : NULL;
+    }
+
+    void *ptr = mm_memalign(alignment, size);
+    leave();
+
+    if (ptr == NULL && alignment <= MM_ALIGNMENT && libc_malloc)
+    {
+        // arena exhausted, fall back to the next allocator
+        ptr = libc_malloc(size);
+    }
+
+    if (ptr == NULL)
+    {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+// --------- Exported functions ---------
+
+void *malloc(size_t size)
+{
+    return alloc_aligned(MM_ALIGNMENT, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || is_bootstrap(ptr))
+    {
+        return;
+    }
+
+    if (!enter())
+    {
+        // nested free, nothing sensible can be done without re-entering mm_lib
+        return;
+    }
+
+    if (is_managed(ptr))
+    {
+        mm_free(ptr);
+        leave();
+        return;
+    }
+    leave();
+
+    if (libc_free)
+    {
+        libc_free(ptr);
+    }
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (size != 0 && nmemb > ((size_t)-1) / size)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // bootstrap memory is static and therefore already zeroed, mm_lib memory may be reused.
+    // alloc_aligned is called instead of malloc, gcc would otherwise fold malloc + memset back into a call to calloc
+    void *ptr = alloc_aligned(MM_ALIGNMENT, nmemb * size);
+    if (ptr != NULL && !is_bootstrap(ptr))
+    {
+        mm_zero(ptr, nmemb * size);
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return malloc(size);
+    }
+
+    if (is_bootstrap(ptr))
+    {
+        void *new_ptr = malloc(size);
+        if (new_ptr != NULL)
+        {
+            memcpy(new_ptr, ptr, MIN(size, bootstrap_size(ptr)));
+        }
+        return new_ptr;
+    }
+
+    if (!enter())
+    {
+        // nested call, served from the bootstrap buffer like malloc. the old block is left where it is, freeing it would re-enter the allocator
+        void *new_ptr = bootstrap_alloc(size);
+        if (new_ptr == NULL)
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy(new_ptr, ptr, MIN(size, malloc_usable_size(ptr)));
+        return new_ptr;
+    }
+
+    if (is_managed(ptr))
+    {
+        void *new_ptr = mm_realloc(ptr, size);
+        leave();
+
+        if (new_ptr == NULL && size != 0)
+        {
+            errno = ENOMEM;
+        }
+        return new_ptr;
+    }
+    leave();
+
+    return libc_realloc ? libc_realloc(ptr, size) : NULL;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    void *ptr = alloc_aligned(alignment, size);
+    if (ptr == NULL)
+    {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    return alloc_aligned(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return 0;
+    }
+
+    if (is_bootstrap(ptr))
+    {
+        return bootstrap_size(ptr);
+    }
+
+    if (is_managed(ptr))
+    {
+        // only reads the header of a live block, no need to take the lock
+        return mm_usable_size(ptr);
+    }
+
+    return libc_usable_size ? libc_usable_size(ptr) : 0;
+}
@@ -0,0 +1,691 @@
+/**
+ * @file mm_recorder.c
+ * @brief Records the malloc family calls of any dynamically linked program as a driver trace, through LD_PRELOAD.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Usage: MM_RECORD_PATH=test/traces/app.trace LD_PRELOAD=build/libmm_recorder.so python3 -c 'print(1)'
+ *
+ * Every call is forwarded to the next malloc implementation (normally libc) and appended to a buffer owned by the calling thread, so recording takes no locks.
+ * Calls are ordered by a global sequence number. A background thread writes the buffers out to a raw file while the program runs, and when the program exits
+ * the raw calls are sorted, every live pointer gets an id (ids are recycled once their block is freed) and the trace is written in the driver's text format.
+ *
+ * MM_RECORD_PATH        where the trace is written (default mm_record.trace)
+ * MM_RECORD_THREADS     set to 1 to prefix every call with the id of the recording thread, for multi threaded replay
+ * MM_RECORD_TIMESTAMPS  set to 1 to append "@<ns since the first call>" to every call. the driver skips them
+ *
+ * Calls on pointers the recorder never saw allocated (made before it was loaded) are dropped. Forked children are not recorded.
+ */
+
+#define _GNU_SOURCE
+
+#include "utils.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// calls per thread buffer
+#define RECORD_BUFFER_EVENTS (64 * 1024)
+
+// how often the background thread writes the buffers out
+#define RECORD_FLUSH_INTERVAL_NS (1000 * 1000)
+
+#define RECORD_DEFAULT_PATH "mm_record.trace"
+
+// the driver replays up to 64 threads, thread ids past that are folded onto them
+#define RECORD_MAX_THREADS 64
+
+// size of the static buffer used for allocations made while looking up libc
+#define BOOTSTRAP_BUFFER_SIZE (64 * 1024)
+
+typedef enum
+{
+    EVENT_MALLOC,
+    EVENT_FREE,
+    EVENT_REALLOC,
+    EVENT_SKIP // dropped while the trace is written
+} event_type_t;
+
+// a recorded call. while the trace is written ptr is replaced by the id of the block, and old_ptr by the id of a block that has to be freed first (-1 if none)
+typedef struct
+{
+    uint64_t seq;
+    uint64_t timestamp;
+    uintptr_t ptr;     // block returned by malloc/realloc, or the block freed
+    uintptr_t old_ptr; // block passed to realloc
+    uint64_t size;
+    uint32_t thread;
+    uint32_t type;
+} record_event_t;
+
+// a buffer of calls, written by its thread only. the recording thread publishes a call by bumping count, the background thread writes out everything up to count.
+// full buffers are retired by their thread and unmapped once they are written out
+typedef struct event_buffer
+{
+    struct event_buffer *next;
+    uint32_t count;
+    uint32_t flushed;
+    int retired;
+    record_event_t events[RECORD_BUFFER_EVENTS];
+} event_buffer_t;
+
+typedef void *(*libc_malloc_fn_t)(size_t);
+typedef void (*libc_free_fn_t)(void *);
+typedef void *(*libc_calloc_fn_t)(size_t, size_t);
+typedef void *(*libc_realloc_fn_t)(void *, size_t);
+typedef int (*libc_posix_memalign_fn_t)(void **, size_t, size_t);
+typedef void *(*libc_aligned_alloc_fn_t)(size_t, size_t);
+
+static libc_malloc_fn_t libc_malloc = NULL;
+static libc_free_fn_t libc_free = NULL;
+static libc_calloc_fn_t libc_calloc = NULL;
+static libc_realloc_fn_t libc_realloc = NULL;
+static libc_posix_memalign_fn_t libc_posix_memalign = NULL;
+static libc_aligned_alloc_fn_t libc_aligned_alloc = NULL;
+
+// 0 = not initialized, 1 = initialization in progress, 2 = ready
+static volatile int init_state = 0;
+static volatile int recording = 0;
+static pid_t recorder_pid = 0;
+
+static int record_threads = 0;
+static int record_timestamps = 0;
+static char record_path[MAX_STRING_LENGTH];
+static char raw_path[MAX_STRING_LENGTH + 32];
+
+static event_buffer_t *buffers = NULL; // every buffer that is not unmapped yet, newest first
+static uint64_t next_seq = 0;
+static uint32_t next_thread = 0;
+static uint64_t start_ns = 0;
+
+static int raw_fd = -1;
+static pthread_t flusher;
+static volatile int stop_flusher = 0;
+
+static __thread event_buffer_t *thread_buffer __attribute__((tls_model("initial-exec"))) = NULL;
+static __thread int thread_id __attribute__((tls_model("initial-exec"))) = -1;
+
+// set while the recorder itself allocates (dlsym, stdio, writing the trace), those calls are forwarded without being recorded
+static __thread int in_recorder __attribute__((tls_model("initial-exec"))) = 0;
+
+static char bootstrap_buffer[BOOTSTRAP_BUFFER_SIZE] __attribute__((aligned(16)));
+static size_t bootstrap_used = 0;
+
+// --------- Helper functions ---------
+
+static void *bootstrap_alloc(size_t size)
+{
+    size_t total = (size + 15) & ~(size_t)15;
+    size_t offset = __atomic_fetch_add(&bootstrap_used, total, __ATOMIC_RELAXED);
+    return offset + total > BOOTSTRAP_BUFFER_SIZE ? NULL : bootstrap_buffer + offset;
+}
+
+static int is_bootstrap(void *ptr)
+{
+    return (char *)ptr >= bootstrap_buffer && (char *)ptr < bootstrap_buffer + BOOTSTRAP_BUFFER_SIZE;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static event_buffer_t *new_buffer(void)
+{
+    event_buffer_t *buffer = (event_buffer_t *)mmap(NULL, sizeof(event_buffer_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    buffer->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&buffers, &buffer->next, buffer, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return buffer;
+}
+
+static void record(event_type_t type, void *ptr, void *old_ptr, size_t size)
+{
+    if (!recording || in_recorder)
+    {
+        return;
+    }
+
+    event_buffer_t *buffer = thread_buffer;
+    if (buffer == NULL || buffer->count == RECORD_BUFFER_EVENTS)
+    {
+        if (buffer != NULL)
+        {
+            __atomic_store_n(&buffer->retired, 1, __ATOMIC_RELEASE);
+        }
+
+        buffer = thread_buffer = new_buffer();
+        if (buffer == NULL)
+        {
+            return;
+        }
+
+        if (thread_id < 0)
+        {
+            thread_id = __atomic_fetch_add(&next_thread, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    record_event_t *event = &buffer->events[buffer->count];
+    event->seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    event->timestamp = record_timestamps ? now_ns() : 0;
+    event->ptr = (uintptr_t)ptr;
+    event->old_ptr = (uintptr_t)old_ptr;
+    event->size = size;
+    event->thread = thread_id;
+    event->type = type;
+
+    __atomic_store_n(&buffer->count, buffer->count + 1, __ATOMIC_RELEASE);
+}
+
+// writes out the calls recorded since the last flush, and unmaps retired buffers that are fully written. only called by one thread at a time
+static void flush_buffers(void)
+{
+    event_buffer_t *prev = NULL;
+    event_buffer_t *buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+
+    while (buffer != NULL)
+    {
+        int retired = __atomic_load_n(&buffer->retired, __ATOMIC_ACQUIRE);
+        uint32_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+
+        if (count > buffer->flushed)
+        {
+            size_t size = (count - buffer->flushed) * sizeof(record_event_t);
+            if (write(raw_fd, &buffer->events[buffer->flushed], size) != (ssize_t)size)
+            {
+                recording = 0;
+            }
+            buffer->flushed = count;
+        }
+
+        event_buffer_t *next = buffer->next;
+
+        // new buffers are only ever pushed at the head, so any other buffer can be unlinked without racing the recording threads
+        if (retired && prev != NULL)
+        {
+            prev->next = next;
+            munmap(buffer, sizeof(event_buffer_t));
+        }
+        else
+        {
+            prev = buffer;
+        }
+        buffer = next;
+    }
+}
+
+static void *flusher_main(void *arg)
+{
+    (void)arg;
+    in_recorder = 1;
+
+    struct timespec interval = {0, RECORD_FLUSH_INTERVAL_NS};
+    while (!stop_flusher)
+    {
+        nanosleep(&interval, NULL);
+        flush_buffers();
+    }
+    return NULL;
+}
+
+static void stop_recording_in_child(void)
+{
+    recording = 0;
+}
+
+// --------- Writing the trace ---------
+
+// open addressing map from live pointers to their ids, with linear probing and backward shift deletion
+typedef struct
+{
+    uintptr_t *keys; // 0 = empty
+    int *ids;
+    size_t capacity; // power of two
+    size_t size;
+} ptr_map_t;
+
+static size_t ptr_map_slot(ptr_map_t *map, uintptr_t key)
+{
+    size_t slot = (key >> 4) * 0x9e3779b97f4a7c15ull;
+    slot &= map->capacity - 1;
+    while (map->keys[slot] != 0 && map->keys[slot] != key)
+    {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return slot;
+}
+
+static void ptr_map_init(ptr_map_t *map, size_t capacity)
+{
+    map->keys = (uintptr_t *)calloc(capacity, sizeof(uintptr_t));
+    map->ids = (int *)malloc(capacity * sizeof(int));
+    map->capacity = capacity;
+    map->size = 0;
+}
+
+static int ptr_map_get(ptr_map_t *map, uintptr_t key)
+{
+    size_t slot = ptr_map_slot(map, key);
+    return map->keys[slot] == key ? map->ids[slot] : -1;
+}
+
+static void ptr_map_put(ptr_map_t *map, uintptr_t key, int id)
+{
+    if (2 * (map->size + 1) > map->capacity)
+    {
+        ptr_map_t grown;
+        ptr_map_init(&grown, map->capacity * 2);
+        for (size_t i = 0; i < map->capacity; i++)
+        {
+            if (map->keys[i] != 0)
+            {
+                size_t slot = ptr_map_slot(&grown, map->keys[i]);
+                grown.keys[slot] = map->keys[i];
+                grown.ids[slot] = map->ids[i];
+            }
+        }
+        grown.size = map->size;
+        free(map->keys);
+        free(map->ids);
+        *map = grown;
+    }
+
+    size_t slot = ptr_map_slot(map, key);
+    map->size += map->keys[slot] == 0;
+    map->keys[slot] = key;
+    map->ids[slot] = id;
+}
+
+static void ptr_map_remove(ptr_map_t *map, uintptr_t key)
+{
+    size_t slot = ptr_map_slot(map, key);
+    if (map->keys[slot] != key)
+    {
+        return;
+    }
+
+    map->keys[slot] = 0;
+    map->size--;
+
+    // move later entries of the probe sequence back into the hole
+    size_t next = (slot + 1) & (map->capacity - 1);
+    while (map->keys[next] != 0)
+    {
+        uintptr_t key_next = map->keys[next];
+        int id_next = map->ids[next];
+        map->keys[next] = 0;
+        map->size--;
+        ptr_map_put(map, key_next, id_next);
+        next = (next + 1) & (map->capacity - 1);
+    }
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    uint64_t seq_a = ((const record_event_t *)a)->seq;
+    uint64_t seq_b = ((const record_event_t *)b)->seq;
+    return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
+// ids of freed blocks are handed out again, so that the driver's id table stays as small as the peak number of live blocks
+typedef struct
+{
+    int *free_ids;
+    int num_free;
+    int capacity;
+    int next_id;
+} id_pool_t;
+
+static int take_id(id_pool_t *pool)
+{
+    return pool->num_free > 0 ? pool->free_ids[--pool->num_free] : pool->next_id++;
+}
+
+static void release_id(id_pool_t *pool, int id)
+{
+    if (pool->num_free == pool->capacity)
+    {
+        pool->capacity = MAX(1024, pool->capacity * 2);
+        pool->free_ids = (int *)realloc(pool->free_ids, pool->capacity * sizeof(int));
+    }
+    pool->free_ids[pool->num_free++] = id;
+}
+
+// binds the block at ptr to an id. a block that is still bound belonged to a call whose release raced this one, its id is freed first (returned, -1 if none)
+static int bind_ptr(ptr_map_t *map, id_pool_t *pool, uintptr_t ptr, int id)
+{
+    int stale = ptr_map_get(map, ptr);
+    if (stale >= 0)
+    {
+        release_id(pool, stale);
+    }
+    ptr_map_put(map, ptr, id);
+    return stale;
+}
+
+// turns the raw calls into a trace with ids. returns 0 on success
+static int write_trace(void)
+{
+    int fd = open(raw_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        return 1;
+    }
+
+    size_t num_events = st.st_size / sizeof(record_event_t);
+    record_event_t *events = NULL;
+    if (num_events > 0)
+    {
+        events = (record_event_t *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (events == MAP_FAILED)
+    {
+        return 1;
+    }
+
+    // every thread's buffer is in order already, but the threads are interleaved
+    qsort(events, num_events, sizeof(record_event_t), compare_events);
+
+    ptr_map_t map;
+    ptr_map_init(&map, 1024);
+    id_pool_t pool = {NULL, 0, 0, 0};
+    uint64_t counts[3] = {0, 0, 0};
+
+    for (size_t i = 0; i < num_events; i++)
+    {
+        record_event_t *event = &events[i];
+        int stale = -1;
+        int id = -1;
+
+        // realloc(NULL, size) is a malloc, realloc(ptr, 0) a free, and a realloc of a block from before the recording started a malloc of the new block
+        if (event->type == EVENT_REALLOC)
+        {
+            if (event->ptr == 0)
+                event->type = EVENT_FREE, event->ptr = event->old_ptr;
+            else if (event->old_ptr == 0 || ptr_map_get(&map, event->old_ptr) < 0)
+                event->type = EVENT_MALLOC;
+        }
+
+        switch (event->type)
+        {
+        case EVENT_MALLOC:
+            id = take_id(&pool);
+            stale = bind_ptr(&map, &pool, event->ptr, id);
+            break;
+        case EVENT_FREE:
+            id = ptr_map_get(&map, event->ptr);
+            if (id >= 0)
+            {
+                ptr_map_remove(&map, event->ptr);
+                release_id(&pool, id);
+            }
+            break;
+        case EVENT_REALLOC:
+            id = ptr_map_get(&map, event->old_ptr);
+            ptr_map_remove(&map, event->old_ptr);
+            stale = bind_ptr(&map, &pool, event->ptr, id);
+            break;
+        }
+
+        if (id < 0)
+        {
+            event->type = EVENT_SKIP;
+            continue;
+        }
+
+        event->ptr = id;
+        event->old_ptr = stale;
+        counts[event->type]++;
+        counts[EVENT_FREE] += stale >= 0;
+    }
+
+    // written next to the trace and renamed over it, so that processes exiting at the same time don't interleave their traces
+    char tmp_path[MAX_STRING_LENGTH + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", record_path, (int)getpid());
+    FILE *out = fopen(tmp_path, "w");
+    if (out == NULL)
+    {
+        return 1;
+    }
+
+    fprintf(out, "%lu\n%lu\n%lu\n%lu\n", counts[0] + counts[1] + counts[2], counts[EVENT_MALLOC], counts[EVENT_FREE], counts[EVENT_REALLOC]);
+
+    uint64_t first_ns = num_events > 0 ? events[0].timestamp : 0;
+    for (size_t i = 0; i < num_events; i++)
+    {
+        record_event_t *event = &events[i];
+        if (event->type == EVENT_SKIP)
+            continue;
+
+        char thread[16] = "";
+        char timestamp[32] = "";
+        if (record_threads)
+            snprintf(thread, sizeof(thread), "%u ", event->thread % RECORD_MAX_THREADS);
+        if (record_timestamps)
+            snprintf(timestamp, sizeof(timestamp), " @%lu", event->timestamp - first_ns);
+
+        if ((intptr_t)event->old_ptr >= 0)
+            fprintf(out, "%sF %ld%s\n", thread, (long)event->old_ptr, timestamp);
+
+        if (event->type == EVENT_MALLOC)
+            fprintf(out, "%sM %lu %lu%s\n", thread, event->ptr, event->size, timestamp);
+        else if (event->type == EVENT_FREE)
+            fprintf(out, "%sF %lu%s\n", thread, event->ptr, timestamp);
+        else
+            fprintf(out, "%sR %lu %lu%s\n", thread, event->ptr, event->size, timestamp);
+    }
+
+    if (fclose(out) != 0 || rename(tmp_path, record_path) != 0)
+    {
+        unlink(tmp_path);
+        return 1;
+    }
+    if (events != NULL)
+    {
+        munmap(events, st.st_size);
+    }
+    free(map.keys);
+    free(map.ids);
+    free(pool.free_ids);
+
+    fprintf(stderr, "mm_recorder: wrote %lu calls to %s\n", counts[0] + counts[1] + counts[2], record_path);
+    return 0;
+}
+
+// --------- Setup and teardown ---------
+
+static void init(void)
+{
+    if (__atomic_load_n(&init_state, __ATOMIC_ACQUIRE) == 2)
+    {
+        return;
+    }
+
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&init_state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        // another thread is initializing, a nested call on this thread is served from the bootstrap buffer by the caller
+        while (!in_recorder && __atomic_load_n(&init_state, __ATOMIC_ACQUIRE) != 2)
+            ;
+        return;
+    }
+
+    in_recorder = 1;
+    libc_malloc = (libc_malloc_fn_t)dlsym(RTLD_NEXT, "malloc");
+    libc_free = (libc_free_fn_t)dlsym(RTLD_NEXT, "free");
+    libc_calloc = (libc_calloc_fn_t)dlsym(RTLD_NEXT, "calloc");
+    libc_realloc = (libc_realloc_fn_t)dlsym(RTLD_NEXT, "realloc");
+    libc_posix_memalign = (libc_posix_memalign_fn_t)dlsym(RTLD_NEXT, "posix_memalign");
+    libc_aligned_alloc = (libc_aligned_alloc_fn_t)dlsym(RTLD_NEXT, "aligned_alloc");
+
+    const char *path = getenv("MM_RECORD_PATH");
+    snprintf(record_path, sizeof(record_path), "%s", path ? path : RECORD_DEFAULT_PATH);
+    record_threads = getenv("MM_RECORD_THREADS") && atoi(getenv("MM_RECORD_THREADS"));
+    record_timestamps = getenv("MM_RECORD_TIMESTAMPS") && atoi(getenv("MM_RECORD_TIMESTAMPS"));
+
+    // one raw file per process, wrapper scripts and the programs they exec all load the recorder
+    snprintf(raw_path, sizeof(raw_path), "%s.%d.raw", record_path, (int)getpid());
+    raw_fd = open(raw_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    recorder_pid = getpid();
+    start_ns = now_ns();
+    pthread_atfork(NULL, NULL, stop_recording_in_child);
+
+    if (raw_fd >= 0 && pthread_create(&flusher, NULL, flusher_main, NULL) == 0)
+    {
+        recording = 1;
+    }
+    else
+    {
+        fprintf(stderr, "mm_recorder: can't record to %s\n", raw_path);
+    }
+    in_recorder = 0;
+
+    __atomic_store_n(&init_state, 2, __ATOMIC_RELEASE);
+}
+
+__attribute__((constructor)) static void recorder_start(void)
+{
+    init();
+}
+
+__attribute__((destructor)) static void recorder_finish(void)
+{
+    if (!recording || getpid() != recorder_pid)
+    {
+        return;
+    }
+
+    recording = 0;
+    in_recorder = 1;
+
+    stop_flusher = 1;
+    pthread_join(flusher, NULL);
+    flush_buffers();
+    close(raw_fd);
+
+    if (write_trace() != 0)
+    {
+        fprintf(stderr, "mm_recorder: failed to write %s, the raw calls are left in %s\n", record_path, raw_path);
+    }
+    else
+    {
+        unlink(raw_path);
+    }
+}
+
+// --------- Exported functions ---------
+
+void *malloc(size_t size)
+{
+    init();
+    if (libc_malloc == NULL)
+    {
+        return bootstrap_alloc(size);
+    }
+
+    void *ptr = libc_malloc(size);
+    if (ptr != NULL)
+    {
+        record(EVENT_MALLOC, ptr, NULL, size);
+    }
+    return ptr;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || is_bootstrap(ptr))
+    {
+        return;
+    }
+
+    // recorded before the block is released, so that a malloc on another thread that gets the same block is ordered after it
+    record(EVENT_FREE, ptr, NULL, 0);
+    libc_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    init();
+    if (libc_calloc == NULL)
+    {
+        // the bootstrap buffer is static and therefore already zeroed
+        return size != 0 && nmemb > ((size_t)-1) / size ? NULL : bootstrap_alloc(nmemb * size);
+    }
+
+    void *ptr = libc_calloc(nmemb, size);
+    if (ptr != NULL)
+    {
+        record(EVENT_MALLOC, ptr, NULL, nmemb * size);
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    init();
+    if (is_bootstrap(ptr) || libc_realloc == NULL)
+    {
+        void *new_ptr = malloc(size);
+        if (new_ptr != NULL && ptr != NULL)
+        {
+            memcpy(new_ptr, ptr, MIN(size, (size_t)(bootstrap_buffer + BOOTSTRAP_BUFFER_SIZE - (char *)ptr)));
+        }
+        return new_ptr;
+    }
+
+    void *new_ptr = libc_realloc(ptr, size);
+    if (new_ptr != NULL || size == 0)
+    {
+        record(EVENT_REALLOC, new_ptr, ptr, size);
+    }
+    return new_ptr;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    init();
+    int result = libc_posix_memalign(memptr, alignment, size);
+    if (result == 0)
+    {
+        record(EVENT_MALLOC, *memptr, NULL, size);
+    }
+    return result;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    init();
+    void *ptr = libc_aligned_alloc(alignment, size);
+    if (ptr != NULL)
+    {
+        record(EVENT_MALLOC, ptr, NULL, size);
+    }
+    return ptr;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
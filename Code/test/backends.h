@@ -0,0 +1,87 @@
+/**
+ * @file backends.h
+ * @brief Registry of the allocators the test driver can replay traces on, selected with --backends.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Every allocator is linked into the driver under its own names: mm_lib as mm_*, the alternative implementation of src/mm_lib_cpy.c as mm_cpy_* and libc as itself.
+ * Backends with an init function allocate from the simulated heap of core_mem, which is reset before every trace, so heap size and utilization are only measured for them.
+ * Optional functions a backend doesn't have are NULL, and the driver skips what depends on them.
+ */
+
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include "mm_lib.h"
+#include "mm_lib_cpy.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void *(*allocator_fn_t)(size_t);
+typedef void (*deallocator_fn_t)(void *);
+typedef void *(*reallocator_fn_t)(void *, size_t);
+
+typedef struct
+{
+    const char *name;
+    void (*init)(void); // sets the allocator up on a fresh simulated heap, NULL for allocators that get their memory elsewhere
+    allocator_fn_t malloc;
+    deallocator_fn_t free;
+    reallocator_fn_t realloc;
+    size_t (*usable_size)(void *); // NULL if the allocator can't tell, the requested size is used instead
+    mm_stats_t (*get_stats)(void);
+    int (*get_probes)(mm_probes_t *probes); // -1 when the allocator was built without them
+    int (*dump_heap_map)(int fd);
+    const char *scheme; // the fixed scheme of an allocator that ignores SEARCH_SCHEME, NULL if it runs every selected scheme
+    int thread_safe;    // called without the replay's allocator lock by multi threaded traces
+} backend_t;
+
+static const backend_t backends[] = {
+    {
+        .name = "mm_lib",
+        .init = mm_init,
+        .malloc = mm_malloc,
+        .free = mm_free,
+        .realloc = mm_realloc,
+        .usable_size = mm_usable_size,
+        .get_stats = mm_get_stats,
+        .get_probes = mm_get_probes,
+        .dump_heap_map = mm_dump_heap_map,
+    },
+    {
+        .name = "mm_lib_cpy",
+        .init = mm_cpy_init,
+        .malloc = mm_cpy_malloc,
+        .free = mm_cpy_free,
+        .realloc = mm_cpy_realloc,
+        .scheme = "FIRST_FIT",
+    },
+    {
+        .name = "libc",
+        .malloc = malloc,
+        .free = free,
+        .realloc = realloc,
+        .usable_size = malloc_usable_size,
+        .scheme = "LIBC",
+        .thread_safe = 1,
+    },
+};
+
+#define NUM_BACKENDS ((int)(sizeof(backends) / sizeof(backends[0])))
+
+// finds a backend by the first length characters of name, NULL if there is none
+static const backend_t *findBackend(const char *name, size_t length)
+{
+    for (int i = 0; i < NUM_BACKENDS; i++)
+    {
+        if (strlen(backends[i].name) == length && strncmp(backends[i].name, name, length) == 0)
+            return &backends[i];
+    }
+    return NULL;
+}
+
+#endif // BACKENDS_H
@@ -4,24 +4,50 @@
 /* The default path of the traces directory. The program will look for the trace file, specified by name, in the following directory */
 #define TRACE_PATH "test/traces/"
 
+/* Heap maps (see mm_dump_heap_map) are written to this directory when the driver is run with -d. One file is written per scheme and trace. */
+#define HEAP_MAP_PATH "build/heap_maps/"
+
 /* The program runs these trace files by default, if no trace file is provided via the command line args. */
 #define DEFAULT_TRACE_FILES \
     "huge.trace",           \
     "damn.trace",           \
     "huge2.trace",          \
     "malloc_only.trace",    \
-    "easy.trace"
+    "easy.trace",           \
+    "threaded.trace"
 
-#define NUM_DEFAULT_TRACE_FILES 5
+#define NUM_DEFAULT_TRACE_FILES 6
 
 /* These params control the behaviour of the test program */
-/* By default, only the student's allocator is tested. 
-   Only the first fit allocation scheme is run with the trace files.
-   You can however, use the A flag with the program to run the complete test suite.
+/* By default, only mm_lib is tested, with every search scheme.
+   --backends selects other allocators from test/backends.h (comma separated, or all), -l is short for --backends=libc.
+   The search schemes only apply to backends that read SEARCH_SCHEME, the others are run once.
 */
-int EVAL_LIBC = 0;
+const char *BACKENDS = "mm_lib";
 int BEST_FIT  = 1;
 int FIRST_FIT = 1;  // by default run the first fit allocation scheme
 int WORST_FIT = 1;
+int HEAP_MAP_INTERVAL = 0; // dump the heap map every HEAP_MAP_INTERVAL operations, 0 disables the dumps
+
+/* Throughput benchmark mode (-b). After a trace passes, it is replayed BENCH_WARMUP_RUNS times untimed and then BENCH_REPETITIONS times timed, without any checks in the timed region. */
+int BENCH_MODE = 0;
+int BENCH_WARMUP_RUNS = 2;
+int BENCH_REPETITIONS = 10;
+
+/* Hardware counter mode (-p). Cycles, instructions and cache, TLB and branch misses are counted over the timed benchmark repetitions (so -p implies -b) and reported per operation. Counters the kernel doesn't give us are reported as n/a. */
+int PERF_MODE = 0;
+
+/* Streaming mode (-s). Traces are replayed in chunks read ahead by a background thread instead of being loaded whole, so their size isn't limited by memory.
+   Multi threaded traces are replayed on a single thread in this mode. */
+int STREAM_MODE = 0;
+
+/* Machine readable results (--format=json|csv) are written to RESULTS_PATH.<format> unless --output is given. */
+#define RESULTS_PATH "build/results"
+
+/* Baseline gating (--baseline). The run fails if throughput or peak utilization of any trace drops more than BASELINE_TOLERANCE percent below the baseline. */
+const char *RESULTS_FORMAT = NULL;
+const char *RESULTS_OUTPUT = NULL;
+const char *BASELINE_FILE = NULL;
+double BASELINE_TOLERANCE = 5.0;
 // int SLAB_ALLOC = 0;
 // int NEXT_FIT = 0;
\ No newline at end of file
@@ -0,0 +1,87 @@
+import struct
+import sys
+import zlib
+
+# Renders the heap maps written by the driver (-d N) as a heap occupancy image.
+# Every snapshot becomes one row of the image (top to bottom in operation order), and the x axis is the heap offset, scaled so that the largest heap fits the image width.
+# Fully used pixels are dark, fully free pixels are light and anything past the heap end of that snapshot is black. Mixed pixels are shaded by the fraction of used bytes.
+# usage: python3 heap_map_render.py <heap map csv> [output png] [width]
+
+FREE_COLOR = (235, 235, 220)
+USED_COLOR = (200, 40, 40)
+OUTSIDE_COLOR = (0, 0, 0)
+
+# minimum height of a snapshot row, so that short traces don't end up as a thin strip
+MIN_IMAGE_HEIGHT = 200
+
+def parse_heap_map(path):
+    snapshots = []
+    with open(path, "r") as f:
+        for line in f:
+            if line.startswith("#"):
+                fields = dict(field.split("=") for field in line[1:].split())
+                snapshots.append({"op": int(fields["op"]), "heap": int(fields["heap"]), "blocks": []})
+            elif line.strip():
+                offset, size, state = line.strip().split(",")
+                snapshots[-1]["blocks"].append((int(offset), int(size), state == "U"))
+    return snapshots
+
+def render_row(snapshot, width, bytes_per_pixel):
+    used = [0.0] * width
+    for offset, size, is_used in snapshot["blocks"]:
+        if not is_used:
+            continue
+        # spread the used bytes of the block over the pixels it covers
+        start, end = offset, offset + size
+        pixel = int(start // bytes_per_pixel)
+        while start < end and pixel < width:
+            pixel_end = (pixel + 1) * bytes_per_pixel
+            covered = min(end, pixel_end) - start
+            used[pixel] += covered / bytes_per_pixel
+            start += covered
+            pixel += 1
+
+    row = bytearray()
+    heap_pixels = snapshot["heap"] / bytes_per_pixel
+    for pixel in range(width):
+        if pixel >= heap_pixels:
+            row.extend(OUTSIDE_COLOR)
+            continue
+        fraction = min(1.0, used[pixel])
+        row.extend(int(f + (u - f) * fraction) for f, u in zip(FREE_COLOR, USED_COLOR))
+    return bytes(row)
+
+def write_png(path, width, rows):
+    def chunk(kind, data):
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data) & 0xFFFFFFFF)
+
+    raw = b"".join(b"\x00" + row for row in rows)
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, len(rows), 8, 2, 0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        f.write(chunk(b"IEND", b""))
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: python3 heap_map_render.py <heap map csv> [output png] [width]")
+        sys.exit(1)
+
+    heap_map = sys.argv[1]
+    output = sys.argv[2] if len(sys.argv) > 2 else heap_map.rsplit(".", 1)[0] + ".png"
+    width = int(sys.argv[3]) if len(sys.argv) > 3 else 1024
+
+    snapshots = parse_heap_map(heap_map)
+    if not snapshots:
+        print(f"No snapshots found in {heap_map}")
+        sys.exit(1)
+
+    max_heap = max(snapshot["heap"] for snapshot in snapshots)
+    bytes_per_pixel = max(1, max_heap) / width
+
+    rows = [render_row(snapshot, width, bytes_per_pixel) for snapshot in snapshots]
+    repeat = max(1, MIN_IMAGE_HEIGHT // len(rows))
+    rows = [row for row in rows for _ in range(repeat)]
+
+    write_png(output, width, rows)
+    print(f"Rendered {len(snapshots)} snapshots of up to {max_heap / 1024:.1f} kB to {output} ({bytes_per_pixel:.1f} bytes/pixel)")
@@ -0,0 +1,140 @@
+/**
+ * @file histogram.h
+ * @brief Log-linear latency histograms and a monotonic nanosecond timer for the test driver.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Values below 2^HIST_SUB_BUCKET_BITS get a bucket each, every power of two above that is split into 2^HIST_SUB_BUCKET_BITS linear sub buckets.
+ * Recording is a couple of bit operations and an increment, and percentiles are accurate to within 1/2^HIST_SUB_BUCKET_BITS of the value.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define HIST_SUB_BUCKET_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BUCKET_BITS)
+#define HIST_NUM_BUCKETS ((64 - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKETS)
+
+// number of back to back timer reads used to estimate the timer overhead
+#define TIMER_CALIBRATION_ROUNDS 10000
+
+typedef struct
+{
+    uint64_t counts[HIST_NUM_BUCKETS];
+    uint64_t total; // number of recorded values
+    uint64_t sum;   // sum of the recorded values, for the average
+    uint64_t max;   // exact maximum
+} histogram_t;
+
+// overhead of a single timer read in ns, subtracted from every measurement
+static uint64_t timer_overhead_ns = 0;
+
+static inline uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// the smallest difference of two back to back reads is the cost of the timer itself
+static void calibrateTimer(void)
+{
+    uint64_t min_delta = UINT64_MAX;
+    for (int i = 0; i < TIMER_CALIBRATION_ROUNDS; i++)
+    {
+        uint64_t start = nowNs();
+        uint64_t end = nowNs();
+        if (end - start < min_delta)
+            min_delta = end - start;
+    }
+    timer_overhead_ns = min_delta;
+}
+
+// elapsed time between two timer reads with the timer overhead removed
+static inline uint64_t elapsedNs(uint64_t start, uint64_t end)
+{
+    uint64_t delta = end - start;
+    return delta > timer_overhead_ns ? delta - timer_overhead_ns : 0;
+}
+
+static inline int histBucket(uint64_t value)
+{
+    if (value < HIST_SUB_BUCKETS)
+        return (int)value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    int sub_bucket = (int)(value >> (exponent - HIST_SUB_BUCKET_BITS)) & (HIST_SUB_BUCKETS - 1);
+    return (exponent - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKETS + sub_bucket;
+}
+
+// the largest value that falls into the bucket
+static inline uint64_t histBucketValue(int bucket)
+{
+    if (bucket < HIST_SUB_BUCKETS)
+        return (uint64_t)bucket;
+
+    int exponent = bucket / HIST_SUB_BUCKETS + HIST_SUB_BUCKET_BITS - 1;
+    uint64_t sub_bucket = (uint64_t)(bucket % HIST_SUB_BUCKETS);
+    uint64_t width = 1ull << (exponent - HIST_SUB_BUCKET_BITS);
+    return ((HIST_SUB_BUCKETS + sub_bucket) << (exponent - HIST_SUB_BUCKET_BITS)) + width - 1;
+}
+
+static inline void histInit(histogram_t *hist)
+{
+    memset(hist, 0, sizeof(histogram_t));
+}
+
+static inline void histRecord(histogram_t *hist, uint64_t value)
+{
+    hist->counts[histBucket(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+static inline void histMerge(histogram_t *into, const histogram_t *from)
+{
+    for (int i = 0; i < HIST_NUM_BUCKETS; i++)
+        into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->max > into->max)
+        into->max = from->max;
+}
+
+// returns the value at the given percentile (0-100), capped at the exact maximum
+static uint64_t histPercentile(const histogram_t *hist, double percentile)
+{
+    if (hist->total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_NUM_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t value = histBucketValue(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static inline double histMean(const histogram_t *hist)
+{
+    return hist->total ? (double)hist->sum / hist->total : 0.0;
+}
+
+#endif // HISTOGRAM_H
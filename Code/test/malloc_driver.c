@@ -1,7 +1,12 @@
 #include "mm_lib.h"
+#include "backends.h"
 #include "core_mem.h"
 #include "utils.h"
 #include "pretty_tests.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "trace_format.h"
+#include "trace_stream.h"
 #include "config.h"
 
 #include <string.h>
@@ -9,6 +14,15 @@
 #include <unistd.h>
 #include <assert.h>
 #include <time.h>
+#include <math.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #ifdef DEBUG
 #undef DEBUG
@@ -22,6 +36,12 @@
 
 #define SEARCH_SCHEME_ENV "SEARCH_SCHEME"
 
+// the largest number of rows read from a baseline file
+#define MAX_BASELINE_ROWS 1024
+
+// the largest number of backend and scheme combinations run by one driver run
+#define MAX_RUNS (NUM_BACKENDS * 4)
+
 // define the list of tests to be run here.
 // this will be used with X macros to avoid a lot of repetition
 #define LIST_OF_TESTS \
@@ -29,10 +49,6 @@
     X(WORST_FIT)      \
     X(BEST_FIT)
 
-typedef void *(*allocator_fn_t)(size_t);
-typedef void (*deallocator_fn_t)(void *);
-typedef void *(*reallocator_fn_t)(void *, size_t);
-
 // Just a macro to make the code look cleaner, i really couldnt add this after every malloc call
 #define ASSERT_MALLOC(ptr)                      \
     if (ptr == NULL)                            \
@@ -43,30 +59,35 @@ typedef void *(*reallocator_fn_t)(void *, size_t);
     }
 
 /* Compound types and structs */
-// represents a single malloc/free/realloc call, belonging to a unique malloc call.
-typedef struct
-{
-    enum
-    {
-        MALLOC,
-        FREE,
-        REALLOC
-    } type;   // type of request
-    int id;   // id of the malloc call
-    int size; // size of the malloc/realloc call
-} trace_req_t;
+// a single malloc/free/realloc call (trace_req_t) is defined in trace_format.h, binary traces store it as is.
 
-// represents the memory blocks in the heap.
-typedef struct memblock_node
+// represents a memory block in the heap. blocks are stored in a table indexed by the id of their malloc call.
+typedef struct
 {
     char *start;
     char *end;
 
-    int id;
     size_t size;
+    size_t usable; // usable size of the block as reported by the allocator
+    int live;      // whether the block is currently allocated
+
+    // links of the treap (a randomized balanced tree) of live blocks ordered by start address, -1 if there is no child
+    int left;
+    int right;
+    unsigned int priority;
+} memblock_t;
 
-    struct memblock_node *next;
-} memblock_node_t;
+// table of memory blocks indexed by id, built at parse time so that looking up the block of a free/realloc call is O(1).
+// the live blocks are also linked into a treap by their ids, so that checking a new block for overlaps is O(log n).
+typedef struct
+{
+    memblock_t *blocks;
+    int num_blocks; // size of the table, one more than the largest id in the trace
+
+    int num_live;
+    size_t usable_in_use; // sum of the usable sizes of the live blocks
+    int root;             // id of the treap root, -1 if there are no live blocks
+} memblock_table_t;
 
 // contains the stats
 typedef struct
@@ -75,12 +96,34 @@ typedef struct
     size_t memory_in_use;
     size_t heap_size;
 
-    double total_malloc_time;
-    size_t ran_mallocs;
-    double total_free_time;
-    size_t ran_frees;
-    double total_realloc_time;
-    size_t ran_reallocs;
+    // tracked after every operation of the trace
+    size_t peak_memory_in_use;
+    size_t peak_heap_size;
+    double util_sum;     // sum of memory_in_use / heap_size, for the time weighted average utilization
+    double int_frag_sum; // sum of 1 - memory_in_use / usable bytes in use, for the time weighted average internal fragmentation
+    size_t sampled_ops;
+
+    // per call latencies in ns, the counts and averages come from the histograms as well
+    histogram_t malloc_latency;
+    histogram_t free_latency;
+    histogram_t realloc_latency;
+
+    // throughput over the timed benchmark runs (-b), in ops/sec
+    int bench_runs;
+    double bench_mean;
+    double bench_stddev;
+    double bench_min;
+    double bench_max;
+
+    // hardware counters over the timed benchmark repetitions (-p), and the number of operations they cover
+    perf_counts_t perf;
+    uint64_t perf_ops;
+
+    mm_stats_t alloc_stats; // allocator internal stats at the end of the trace
+
+    // per call probes of the allocator over the checked run (see mm_get_probes), only if it was built with them
+    mm_probes_t probes;
+    int has_probes;
 } test_stats_t;
 
 // contains information about the trace file.
@@ -88,17 +131,58 @@ typedef struct
 {
     int num_ids;  // number of unique malloc ids. each id with a free/realloc/malloc corresponds to a unique malloc call.
     int num_reqs; // total number of malloc/free/realloc calls
+    int num_threads; // number of threads the trace is replayed on
 
-    trace_req_t *reqs;          // array of malloc/free/realloc calls
-    memblock_node_t *memblocks; // linked list of memory blocks
+    trace_req_t *reqs;          // array of malloc/free/realloc calls, NULL if the trace is streamed or has been released
+    size_t map_size;            // length of the mapping reqs lies in for a binary trace, 0 if reqs was allocated
+    memblock_table_t memblocks; // memory blocks, indexed by id
 
     test_stats_t stats; // stats for the test
 
     char *trace_name; // name of the trace file
 } trace_file_t;
 
+// state shared by the threads replaying a multi threaded trace.
+// the calls on an id are kept in trace order across threads: a call waits until next_seq of its id reaches its own seq, so that e.g. a free on one thread never overtakes the malloc on another.
+typedef struct
+{
+    trace_file_t *trace_file;
+    int checked; // whether the blocks are checked and stats recorded (runTrace) or the trace is only timed (benchTrace)
+
+    int *next_seq; // per id, the seq of the next call allowed to run on it
+    void **ptrs;   // per id pointers of the unchecked replay
+
+    pthread_mutex_t alloc_lock; // mm_lib is not thread safe, calls into it are serialized. libc is called without the lock
+    pthread_mutex_t check_lock; // protects the block table and the stats of the checked replay
+    pthread_barrier_t start;    // releases all threads at once, after the main thread has read the start time
+    volatile int failed;
+} replay_t;
+
+// a single replay thread, with the indices of its calls in the trace and its own latency histograms
+typedef struct
+{
+    replay_t *replay;
+    pthread_t handle;
+
+    int *reqs;
+    int num_reqs;
+
+    histogram_t malloc_latency;
+    histogram_t free_latency;
+    histogram_t realloc_latency;
+} replay_thread_t;
+
+// the traces replayed on one backend with one scheme, NULL entries for traces that failed
+typedef struct
+{
+    const backend_t *backend;
+    const char *scheme;
+    trace_file_t **traces;
+} run_t;
+
 /* Globals */
-// the memory management functions to use, by default they are student's functions
+// the backend the traces are replayed on, and its memory management functions. set with useBackend
+static const backend_t *BACKEND = &backends[0];
 static allocator_fn_t ALLOC_ALLOC = &mm_malloc;
 static deallocator_fn_t ALLOC_FREE = &mm_free;
 static reallocator_fn_t ALLOC_REALLOC = &mm_realloc;
@@ -108,29 +192,126 @@ static char *default_trace_files[] = {
     NULL
 };
 
+// a row of a baseline results file, only the gated metrics are kept
+typedef struct
+{
+    char allocator[MAX_STRING_LENGTH];
+    char scheme[MAX_STRING_LENGTH];
+    char trace_name[MAX_STRING_LENGTH];
+    double ops_per_sec;
+    double peak_util;
+} baseline_row_t;
+
+static baseline_row_t *baseline_rows = NULL;
+static int num_baseline_rows = 0;
+
+// set once the first result has been written, so that json results get their separators right
+static int results_written = 0;
+
+// the metrics written for every scheme and trace with --format, as X(name, printf format, value)
+#define LIST_OF_METRICS(trace)                                                                \
+    X(ops, "%d", (trace)->num_reqs)                                                           \
+    X(requested_kb, "%.3f", (trace)->stats.total_requested_memory / 1024.0)                   \
+    X(in_use_kb, "%.3f", (trace)->stats.memory_in_use / 1024.0)                               \
+    X(heap_kb, "%.3f", (trace)->stats.heap_size / 1024.0)                                     \
+    X(peak_util, "%.4f", peakUtil(trace))                                                     \
+    X(avg_util, "%.4f", (trace)->stats.util_sum / MAX((trace)->stats.sampled_ops, 1))        \
+    X(int_frag, "%.4f", (trace)->stats.int_frag_sum / MAX((trace)->stats.sampled_ops, 1))    \
+    X(ops_per_sec, "%.0f", opsPerSec(trace))                                                  \
+    X(bench_runs, "%d", (trace)->stats.bench_runs)                                            \
+    X(bench_mean, "%.0f", (trace)->stats.bench_mean)                                          \
+    X(bench_stddev, "%.0f", (trace)->stats.bench_stddev)                                      \
+    X(bench_min, "%.0f", (trace)->stats.bench_min)                                            \
+    X(bench_max, "%.0f", (trace)->stats.bench_max)                                            \
+    LIST_OF_LATENCY_METRICS(malloc, &(trace)->stats.malloc_latency)                           \
+    LIST_OF_LATENCY_METRICS(realloc, &(trace)->stats.realloc_latency)                         \
+    LIST_OF_LATENCY_METRICS(free, &(trace)->stats.free_latency)                               \
+    LIST_OF_PERF_METRICS(trace)                                                               \
+    X(splits, "%zu", (trace)->stats.alloc_stats.splits)                                       \
+    X(coalesces, "%zu", (trace)->stats.alloc_stats.coalesces)                                 \
+    X(heap_extensions, "%zu", (trace)->stats.alloc_stats.heap_extensions)                     \
+    X(free_list_length, "%zu", (trace)->stats.alloc_stats.free_list_length)                   \
+    X(largest_free_block, "%zu", (trace)->stats.alloc_stats.largest_free_block)
+
+#define LIST_OF_LATENCY_METRICS(op, hist)                   \
+    X(op##_count, "%lu", (hist)->total)                     \
+    X(op##_mean_ns, "%.1f", histMean(hist))                 \
+    X(op##_p50_ns, "%lu", histPercentile(hist, 50))         \
+    X(op##_p99_ns, "%lu", histPercentile(hist, 99))         \
+    X(op##_p999_ns, "%lu", histPercentile(hist, 99.9))      \
+    X(op##_max_ns, "%lu", (hist)->max)
+
+// per operation hardware counts, -1 if the counter wasn't available
+#define LIST_OF_PERF_METRICS(trace)                                                                             \
+    X(cycles_per_op, "%.2f", perfPerOp(&(trace)->stats.perf, PERF_cycles, (trace)->stats.perf_ops))             \
+    X(instructions_per_op, "%.2f", perfPerOp(&(trace)->stats.perf, PERF_instructions, (trace)->stats.perf_ops)) \
+    X(l1d_misses_per_op, "%.4f", perfPerOp(&(trace)->stats.perf, PERF_l1d_misses, (trace)->stats.perf_ops))    \
+    X(llc_misses_per_op, "%.4f", perfPerOp(&(trace)->stats.perf, PERF_llc_misses, (trace)->stats.perf_ops))    \
+    X(dtlb_misses_per_op, "%.4f", perfPerOp(&(trace)->stats.perf, PERF_dtlb_misses, (trace)->stats.perf_ops))  \
+    X(branch_misses_per_op, "%.4f", perfPerOp(&(trace)->stats.perf, PERF_branch_misses, (trace)->stats.perf_ops))
+
 /* Functions declarations */
 // memblock functions
-int addMemBlock(memblock_node_t **head, char *start, int size, int id);
-int removeMemBlock(memblock_node_t **head, int id);
-int cleanupMemBlocks(memblock_node_t **head);
-int verifyOverlap(memblock_node_t *head, char *start, int size);
+int initMemBlocks(memblock_table_t *table, int num_blocks);
+int growMemBlocks(memblock_table_t *table, int num_blocks);
+memblock_t *findMemBlock(memblock_table_t *table, int id);
+int addMemBlock(memblock_table_t *table, char *start, int size, int id);
+int removeMemBlock(memblock_table_t *table, int id);
+int cleanupMemBlocks(memblock_table_t *table);
+int verifyOverlap(memblock_table_t *table, char *start, int size);
+void treapSplit(memblock_table_t *table, int node, char *key, int *lo, int *hi);
+int treapMerge(memblock_table_t *table, int lo, int hi);
+size_t usableSize(void *ptr, size_t size);
 
 // trace file functions
 trace_file_t *parseTraceFile(char *filename);
+trace_file_t *mapTraceFile(const char *path, char *filename);
+trace_file_t *streamTraceFile(char *filename);
+void releaseTraceCalls(trace_file_t *trace_file);
 void cleanUpTrace(trace_file_t *trace_file);
 int runTrace(trace_file_t *trace_file);
+int runStreamedTrace(trace_file_t *trace_file);
+int replayRequest(trace_file_t *trace_file, trace_req_t *request, int index);
+uint64_t replayChunk(trace_req_t *reqs, int num_reqs, void **ptrs);
+uint64_t replayStream(trace_file_t *trace_file, void **ptrs);
+void finishTrace(trace_file_t *trace_file);
+int benchTrace(trace_file_t *trace_file);
+void sampleUtilization(trace_file_t *trace_file);
+
+// multi threaded replay
+int runThreadedTrace(trace_file_t *trace_file);
+uint64_t replayThreads(trace_file_t *trace_file, int checked, void **ptrs);
+void *replayThread(void *arg);
+int replayCall(replay_thread_t *thread, int index);
 
 // testing functions
 int *test_trace_files(char **trace_files, trace_file_t **traces);
 void printStats(trace_file_t **traces, int num_traces);
+void printLatencyRow(const char *trace_name, const char *op, histogram_t *hist);
+void printProbeRow(const char *trace_name, const char *probe_name, mm_probe_t *probe);
+
+// machine readable results and baseline gating
+FILE *openResults(void);
+void closeResults(FILE *fp);
+void writeResults(FILE *fp, const char *allocator, const char *scheme, trace_file_t **traces, int num_traces);
+int loadBaseline(const char *filename);
+int compareBaseline(const char *allocator, const char *scheme, char **trace_files, trace_file_t **traces, int num_traces);
+void printMatrix(run_t *runs, int num_runs, char **trace_files, int num_traces);
+double peakUtil(trace_file_t *trace);
+double opsPerSec(trace_file_t *trace);
 
 // helpers
 void usage(void);
+void useBackend(const backend_t *backend);
+void resetHeap(void);
+int openHeapMap(trace_file_t *trace_file);
+void dumpHeapMap(int fd, int op);
 void dumpHex(const char *ptr, size_t size, int index);
 
 int main(int argc, char *argv[])
 {
     int opt;
+    int exit_code = 0;
     int custom_trace_files = 0;
     int num_trace_files = NUM_DEFAULT_TRACE_FILES;
     char **trace_files = default_trace_files;
@@ -140,6 +321,9 @@ int main(int argc, char *argv[])
     NEWLINE;
     LOG_HEADER("Memory Management Library Test Suite");
     NEWLINE;
+
+    calibrateTimer();
+
 // macro to set the search scheme
 // should set the rest of the schemes from the list of tests to 0
 #define X(scheme)          \
@@ -148,7 +332,16 @@ int main(int argc, char *argv[])
     else                   \
         scheme = 0;
 
-    while ((opt = getopt(argc, argv, "hltFBWS:")) != -1)
+    static struct option long_options[] = {
+        {"format", required_argument, NULL, 1},
+        {"output", required_argument, NULL, 2},
+        {"baseline", required_argument, NULL, 3},
+        {"tolerance", required_argument, NULL, 4},
+        {"backends", required_argument, NULL, 5},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "hltFBWS:d:bw:r:ps", long_options, NULL)) != -1)
     {
         switch (opt)
         {
@@ -156,19 +349,72 @@ int main(int argc, char *argv[])
             usage();
             exit(0);
         case 'l':
-            ALLOC_ALLOC = &malloc;
-            ALLOC_FREE = &free;
-            ALLOC_REALLOC = &realloc;
-            EVAL_LIBC = 1;
-            BEST_FIT = 1;
-            WORST_FIT = 0;
-            FIRST_FIT = 0;
+            BACKENDS = "libc";
             break;
         case 't':
             custom_trace_files = 1;
             num_trace_files = argc - optind;
             trace_files = &argv[optind];
             break;
+        case 'd':
+            HEAP_MAP_INTERVAL = atoi(optarg);
+            if (HEAP_MAP_INTERVAL <= 0)
+            {
+                LOG_ERROR("The heap map interval must be a positive number of operations.\n");
+                exit(1);
+            }
+            break;
+        case 'b':
+            BENCH_MODE = 1;
+            break;
+        case 'p':
+            PERF_MODE = 1;
+            BENCH_MODE = 1;
+            break;
+        case 's':
+            STREAM_MODE = 1;
+            break;
+        case 'w':
+            BENCH_WARMUP_RUNS = atoi(optarg);
+            if (BENCH_WARMUP_RUNS < 0)
+            {
+                LOG_ERROR("The number of warmup runs can't be negative.\n");
+                exit(1);
+            }
+            break;
+        case 'r':
+            BENCH_REPETITIONS = atoi(optarg);
+            if (BENCH_REPETITIONS <= 0)
+            {
+                LOG_ERROR("At least one benchmark repetition is needed.\n");
+                exit(1);
+            }
+            break;
+        case 1:
+            if (strcmp(optarg, "json") != 0 && strcmp(optarg, "csv") != 0)
+            {
+                LOG_ERROR("Unknown results format %s, use json or csv.\n", optarg);
+                exit(1);
+            }
+            RESULTS_FORMAT = optarg;
+            break;
+        case 2:
+            RESULTS_OUTPUT = optarg;
+            break;
+        case 3:
+            BASELINE_FILE = optarg;
+            break;
+        case 4:
+            BASELINE_TOLERANCE = atof(optarg);
+            if (BASELINE_TOLERANCE < 0)
+            {
+                LOG_ERROR("The baseline tolerance can't be negative.\n");
+                exit(1);
+            }
+            break;
+        case 5:
+            BACKENDS = optarg;
+            break;
         case 'F':
         case 'W':
         case 'B':
@@ -176,7 +422,7 @@ int main(int argc, char *argv[])
             LIST_OF_TESTS
             break;
         default:
-            LOG_ERROR("Usage: (driver or make driver ARGS=) [-l] [-B OR -W OR -F OR -S] [-t [trace_file1 [trace_file2 ...]]]\n\n");
+            LOG_ERROR("Usage: (driver or make driver ARGS=) [-l OR --backends=name,...|all] [-B OR -W OR -F OR -S] [-d interval] [-b [-w warmups] [-r repetitions]] [-p] [-s] [--format=json|csv [--output=file]] [--baseline=file [--tolerance=pct]] [-t [trace_file1 [trace_file2 ...]]]\n\n");
             exit(1);
         }
     }
@@ -189,24 +435,80 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    // print the test configuration summary before running the tests
-    LOG_TEST_UNDERLINE("Tests Configuration Summary");
-    LOG_OUT("Using %s memory management functions\n", EVAL_LIBC ? "libc" : "student");
-    if (!EVAL_LIBC)
+    if (BASELINE_FILE && loadBaseline(BASELINE_FILE) != 0)
     {
-        LOG_OUT("Testing algorithms : ");
+        exit(1);
+    }
 
-    #define X(TEST)                \
-        if (TEST)                  \
-        {                          \
-            LOG_OUT("%s ", #TEST); \
+    // every selected scheme is run on the backends that take SEARCH_SCHEME, the others are run once with their own scheme
+    run_t runs[MAX_RUNS];
+    int num_runs = 0;
+    for (const char *name = BACKENDS; *name != '\0';)
+    {
+        size_t length = strcspn(name, ",");
+        int all = length == 3 && strncmp(name, "all", 3) == 0;
+        const backend_t *backend = findBackend(name, length);
+        if (!all && backend == NULL)
+        {
+            LOG_ERROR("Unknown backend %.*s, use one of mm_lib, mm_lib_cpy, libc or all.\n", (int)length, name);
+            exit(1);
         }
-        LIST_OF_TESTS
-        NEWLINE;
-    #undef X
+
+        for (int i = 0; i < NUM_BACKENDS; i++)
+        {
+            if (!all && &backends[i] != backend)
+                continue;
+
+            if (backends[i].scheme)
+            {
+                assert(num_runs < MAX_RUNS);
+                runs[num_runs++] = (run_t){&backends[i], backends[i].scheme, NULL};
+                continue;
+            }
+
+        #define X(SCHEME)                                                   \
+            if (SCHEME)                                                     \
+            {                                                               \
+                assert(num_runs < MAX_RUNS);                                \
+                runs[num_runs++] = (run_t){&backends[i], #SCHEME, NULL};    \
+            }
+            LIST_OF_TESTS
+        #undef X
+        }
+
+        name += length;
+        if (*name == ',')
+            name++;
+    }
+
+    if (num_runs == 0)
+    {
+        LOG_ERROR("No backend or scheme selected.\n");
+        exit(1);
+    }
+
+    // print the test configuration summary before running the tests
+    LOG_TEST_UNDERLINE("Tests Configuration Summary");
+    LOG_OUT("Testing backends : ");
+    for (int r = 0; r < num_runs; r++)
+    {
+        LOG_OUT("%s/%s ", runs[r].backend->name, runs[r].scheme);
     }
+    NEWLINE;
 
     LOG_OUT("Using %s trace files\n", custom_trace_files ? "custom" : "default");
+    if (BENCH_MODE)
+    {
+        LOG_OUT("Benchmarking throughput with %d warmup runs and %d repetitions\n", BENCH_WARMUP_RUNS, BENCH_REPETITIONS);
+    }
+    if (STREAM_MODE)
+    {
+        LOG_OUT("Streaming the traces in chunks of %d calls\n", STREAM_CHUNK_REQS);
+    }
+    if (PERF_MODE)
+    {
+        LOG_OUT("Counting cycles, instructions, cache, TLB and branch misses over the timed repetitions\n");
+    }
     NEWLINE;
 
     LOG_OUT("...\n");
@@ -216,37 +518,22 @@ int main(int argc, char *argv[])
 
     assert(num_trace_files != 0);
 
-    #define X(TEST) \
-        trace_file_t **TEST##_TRACES_ARRAY = NULL; \
-        if (TEST) \
-        { \
-            TEST##_TRACES_ARRAY = malloc((num_trace_files) * sizeof(trace_file_t *)); \
-            for (int i = 0; i < num_trace_files; i++) \
-            { \
-                TEST##_TRACES_ARRAY[i] = NULL; \
-            } \
-        } \
-
-    LIST_OF_TESTS
-    #undef X
-
-// an X macro. basically this same block of code gets executed for all the test names defined in the LIST_OF_TESTS macro, just a handy way to avoid repetition. This way new tests can be added easily by just adding to the list of tests, and without changing anything else in the code.
-#define X(SCHEME)                                                            \
-    if (SCHEME)                                                              \
-    {                                                                        \
-        const char *scheme_string = #SCHEME;                                 \
-        NEWLINE;                                                             \
-        if (!EVAL_LIBC)                                                      \
-            LOG_RUN_TEST("%s\n", scheme_string);                             \
-        setenv(SEARCH_SCHEME_ENV, scheme_string, 1);                         \
-        int *results = test_trace_files(trace_files, SCHEME##_TRACES_ARRAY); \
-        tests_passed += results[0];                                          \
-        total_tests += results[1];                                           \
-        free(results);                                                       \
-    }
-
-    LIST_OF_TESTS
-#undef X
+    for (int r = 0; r < num_runs; r++)
+    {
+        NEWLINE;
+        LOG_RUN_TEST("%s %s\n", runs[r].backend->name, runs[r].scheme);
+
+        useBackend(runs[r].backend);
+        setenv(SEARCH_SCHEME_ENV, runs[r].scheme, 1);
+
+        runs[r].traces = (trace_file_t **)calloc(num_trace_files, sizeof(trace_file_t *));
+        ASSERT_MALLOC(runs[r].traces);
+
+        int *results = test_trace_files(trace_files, runs[r].traces);
+        tests_passed += results[0];
+        total_tests += results[1];
+        free(results);
+    }
 
     NEWLINE;
     LOG_TEST_UNDERLINE("Tests Summary");
@@ -257,30 +544,156 @@ int main(int argc, char *argv[])
 
     LOG_TEST_UNDERLINE("Statistics");
 
-// another one of those. prints stats for each test that was ran, from the LIST_OF_TESTS
-#define X(SCHEME)                                           \
-    if (SCHEME)                                             \
-    {                                                       \
-        NEWLINE;                                            \
-        if (!EVAL_LIBC)                                     \
-            LOG_COLORED(LOG_BOLDGREEN, "%s\n", #SCHEME);    \
-        printStats(SCHEME##_TRACES_ARRAY, num_trace_files); \
+    for (int r = 0; r < num_runs; r++)
+    {
+        NEWLINE;
+        LOG_COLORED(LOG_BOLDGREEN, "%s %s\n", runs[r].backend->name, runs[r].scheme);
+        useBackend(runs[r].backend);
+        printStats(runs[r].traces, num_trace_files);
+    }
+
+    // the runs side by side, once there is more than one to compare
+    if (num_runs > 1)
+    {
+        NEWLINE;
+        LOG_TEST_UNDERLINE("Comparison");
+        printMatrix(runs, num_runs, trace_files, num_trace_files);
     }
 
-        LIST_OF_TESTS
-#undef X
+    // machine readable results for every backend and scheme that was ran
+    if (RESULTS_FORMAT)
+    {
+        FILE *results_fp = openResults();
 
-    return 0;
+        for (int r = 0; r < num_runs; r++)
+        {
+            writeResults(results_fp, runs[r].backend->name, runs[r].scheme, runs[r].traces, num_trace_files);
+        }
+
+        closeResults(results_fp);
+    }
+
+    // compare against the baseline, any regression fails the run
+    if (BASELINE_FILE)
+    {
+        NEWLINE;
+        LOG_TEST_UNDERLINE("Baseline Comparison");
+
+        for (int r = 0; r < num_runs; r++)
+        {
+            if (compareBaseline(runs[r].backend->name, runs[r].scheme, trace_files, runs[r].traces, num_trace_files) != 0)
+                exit_code = 1;
+        }
+
+        if (exit_code != 0)
+            LOG_TEST_FAIL("Regressions beyond %.1f%% of the baseline, or traces of the baseline that failed or weren't run, found.\n", BASELINE_TOLERANCE);
+        else
+            LOG_TEST_SUCCESS("No regressions beyond %.1f%% of the baseline.\n", BASELINE_TOLERANCE);
+    }
+
+    for (int r = 0; r < num_runs; r++)
+    {
+        for (int i = 0; i < num_trace_files; i++)
+        {
+            if (runs[r].traces[i] != NULL)
+                cleanUpTrace(runs[r].traces[i]);
+        }
+        free(runs[r].traces);
+    }
+
+    return exit_code;
 }
 
 /* Functions definitions */
 // memblock functions
-int verifyOverlap(memblock_node_t *head, char *start, int size)
+int initMemBlocks(memblock_table_t *table, int num_blocks)
+{
+    table->blocks = NULL;
+    table->num_blocks = 0;
+    table->num_live = 0;
+    table->usable_in_use = 0;
+    table->root = -1;
+
+    return growMemBlocks(table, num_blocks);
+}
+
+// grows the table to hold num_blocks ids, for streamed traces whose largest id isn't known up front. the treap links are ids, so they stay valid
+int growMemBlocks(memblock_table_t *table, int num_blocks)
 {
-    if (head == NULL)
+    if (num_blocks <= table->num_blocks)
+    {
         return 0;
+    }
 
-    if (!EVAL_LIBC)
+    table->blocks = (memblock_t *)realloc(table->blocks, num_blocks * sizeof(memblock_t));
+    ASSERT_MALLOC(table->blocks);
+
+    for (int i = table->num_blocks; i < num_blocks; i++)
+    {
+        table->blocks[i].live = 0;
+        table->blocks[i].left = -1;
+        table->blocks[i].right = -1;
+
+        // any well mixed hash of the id does as a treap priority, and keeps the runs reproducible
+        table->blocks[i].priority = (unsigned int)i * 2654435761u;
+    }
+
+    table->num_blocks = num_blocks;
+
+    return 0;
+}
+
+memblock_t *findMemBlock(memblock_table_t *table, int id)
+{
+    if (id < 0 || id >= table->num_blocks || !table->blocks[id].live)
+        return NULL;
+
+    return &table->blocks[id];
+}
+
+// splits the treap rooted at node into the blocks starting before key (lo) and the ones starting at or after key (hi)
+void treapSplit(memblock_table_t *table, int node, char *key, int *lo, int *hi)
+{
+    if (node < 0)
+    {
+        *lo = *hi = -1;
+        return;
+    }
+
+    memblock_t *block = &table->blocks[node];
+    if (block->start < key)
+    {
+        treapSplit(table, block->right, key, &block->right, hi);
+        *lo = node;
+    }
+    else
+    {
+        treapSplit(table, block->left, key, lo, &block->left);
+        *hi = node;
+    }
+}
+
+// merges two treaps, where every block in lo starts before every block in hi
+int treapMerge(memblock_table_t *table, int lo, int hi)
+{
+    if (lo < 0)
+        return hi;
+    if (hi < 0)
+        return lo;
+
+    if (table->blocks[lo].priority > table->blocks[hi].priority)
+    {
+        table->blocks[lo].right = treapMerge(table, table->blocks[lo].right, hi);
+        return lo;
+    }
+
+    table->blocks[hi].left = treapMerge(table, lo, table->blocks[hi].left);
+    return hi;
+}
+
+int verifyOverlap(memblock_table_t *table, char *start, int size)
+{
+    if (BACKEND->init)
     {
         // check if the block lies within the bounds of the heap
         if (start < (char *)cm_heap_start() || PTR_ADD(start, size) > cm_heap_end())
@@ -292,24 +705,52 @@ int verifyOverlap(memblock_node_t *head, char *start, int size)
         }
     }
 
-    // check if the new block overlaps with any existing block
-    for (memblock_node_t *curr = head; curr != NULL; curr = curr->next)
+    // the live blocks never overlap each other (an overlap fails the trace), so the new block overlaps some live block
+    // iff it overlaps the live block with the greatest start before its end. that block is found in O(log n) in the treap.
+    char *end = (char *)PTR_ADD(start, MAX(size, 1));
+    memblock_t *curr = NULL;
+
+    for (int node = table->root; node >= 0;)
     {
-        if ((start >= curr->start && start < curr->end) ||
-            ((char *)PTR_ADD(start, size) > curr->start && (char *)PTR_ADD(start, size) <= curr->end))
+        memblock_t *block = &table->blocks[node];
+        if (block->start < end)
         {
-            LOG_ERROR("Memory block overlaps with existing memory blocks\n");
-            LOG_DEBUG("New block: %p - %p, Existing block: %p - %p\n", start, PTR_ADD(start, size), curr->start, curr->end);
-            return 1;
+            curr = block;
+            node = block->right;
+        }
+        else
+        {
+            node = block->left;
         }
     }
 
+    if (curr != NULL && (char *)PTR_ADD(curr->start, MAX(curr->size, 1)) > start)
+    {
+        LOG_ERROR("Memory block overlaps with existing memory blocks\n");
+        LOG_DEBUG("New block: %p - %p, Existing block: %p - %p\n", start, PTR_ADD(start, size), curr->start, curr->end);
+        return 1;
+    }
+
     return 0;
 }
 
-int addMemBlock(memblock_node_t **head, char *start, int size, int id)
+int addMemBlock(memblock_table_t *table, char *start, int size, int id)
 {
-    if (verifyOverlap(*head, start, size) != 0)
+    if (id < 0 || id >= table->num_blocks)
+    {
+        LOG_ERROR("Memory block id out of range\n");
+        LOG_DEBUG("Requested ID: %d, Table size: %d\n", id, table->num_blocks);
+        return 1;
+    }
+
+    if (table->blocks[id].live)
+    {
+        LOG_ERROR("Memory block with this id is already allocated\n");
+        LOG_DEBUG("Requested ID: %d\n", id);
+        return 1;
+    }
+
+    if (verifyOverlap(table, start, size) != 0)
     {
         return 1;
     }
@@ -322,76 +763,67 @@ int addMemBlock(memblock_node_t **head, char *start, int size, int id)
         return 1;
     }
 
-    memblock_node_t *new_node = (memblock_node_t *)malloc(sizeof(memblock_node_t));
-    ASSERT_MALLOC(new_node);
+    memblock_t *block = &table->blocks[id];
 
-    new_node->start = start;
-    new_node->end = start + size;
-    new_node->size = size;
-    new_node->next = *head;
-    new_node->id = id;
+    block->start = start;
+    block->end = start + size;
+    block->size = size;
+    block->usable = usableSize(start, size);
+    block->live = 1;
+    block->left = -1;
+    block->right = -1;
 
-    *head = new_node;
+    int lo, hi;
+    treapSplit(table, table->root, start, &lo, &hi);
+    table->root = treapMerge(table, treapMerge(table, lo, id), hi);
+    table->num_live++;
+    table->usable_in_use += block->usable;
 
     return 0;
 }
 
-int removeMemBlock(memblock_node_t **head, int id)
+int removeMemBlock(memblock_table_t *table, int id)
 {
-    if (*head == NULL)
+    memblock_t *block = findMemBlock(table, id);
+    if (block == NULL)
     {
-        LOG_ERROR("Memory block list is empty\n");
+        LOG_ERROR("Memory block not found\n");
+        LOG_DEBUG("Requested ID: %d\n", id);
         return 1;
     }
 
-    memblock_node_t *curr = *head;
-    memblock_node_t *prev = NULL;
-
-    while (curr != NULL)
-    {
-        if (curr->id == id)
-        {
-            if (prev == NULL)
-            {
-                *head = curr->next;
-            }
-            else
-            {
-                prev->next = curr->next;
-            }
+    // starts are unique, so splitting just before and just after the start isolates the block
+    int lo, mid, hi;
+    treapSplit(table, table->root, block->start, &lo, &hi);
+    treapSplit(table, hi, block->start + 1, &mid, &hi);
+    table->root = treapMerge(table, lo, hi);
+    table->num_live--;
+    table->usable_in_use -= block->usable;
 
-            free(curr);
-            return 0;
-        }
+    block->live = 0;
 
-        prev = curr;
-        curr = curr->next;
-    }
+    return 0;
+}
 
-    LOG_ERROR("Memory block not found\n");
-    LOG_DEBUG("Requested ID: %d\n", id);
-    return 1;
+size_t usableSize(void *ptr, size_t size)
+{
+    return BACKEND->usable_size ? BACKEND->usable_size(ptr) : size;
 }
 
-int cleanupMemBlocks(memblock_node_t **head)
+int cleanupMemBlocks(memblock_table_t *table)
 {
-    if (*head == NULL)
+    if (table->blocks == NULL)
     {
-        LOG_ERROR("Memory block list is empty\n");
+        LOG_ERROR("Memory block table is empty\n");
         return 1;
     }
 
-    memblock_node_t *curr = *head;
-    memblock_node_t *next = NULL;
-
-    while (curr != NULL)
-    {
-        next = curr->next;
-        free(curr);
-        curr = next;
-    }
+    free(table->blocks);
 
-    *head = NULL;
+    table->blocks = NULL;
+    table->num_blocks = 0;
+    table->num_live = 0;
+    table->root = -1;
 
     return 0;
 }
@@ -410,16 +842,26 @@ trace_file_t *parseTraceFile(char *filename)
         exit(1);
     }
 
+    // binary traces are mapped instead of parsed
+    char magic[TRACE_BINARY_MAGIC_SIZE];
+    if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, TRACE_BINARY_MAGIC, sizeof(magic)) == 0)
+    {
+        fclose(fp);
+        return mapTraceFile(path, filename);
+    }
+    rewind(fp);
+
     int num_reqs = 0;
     int num_mallocs = 0;
     int num_frees = 0;
     int num_reallocs = 0;
 
-    // read the header
-    fscanf(fp, "%d", &num_reqs);
-    fscanf(fp, "%d", &num_mallocs);
-    fscanf(fp, "%d", &num_frees);
-    fscanf(fp, "%d", &num_reallocs);
+    // the counts of the header size the request array
+    if (fscanf(fp, "%d %d %d %d", &num_reqs, &num_mallocs, &num_frees, &num_reallocs) != 4 || num_reqs < 0)
+    {
+        LOG_ERROR("Invalid header in trace file %s\n", filename);
+        exit(1);
+    }
 
     // create the trace file
     trace_file_t *trace_file = (trace_file_t *)malloc(sizeof(trace_file_t));
@@ -428,58 +870,44 @@ trace_file_t *parseTraceFile(char *filename)
     trace_file->num_ids = num_mallocs;
     trace_file->num_reqs = num_reqs;
     trace_file->trace_name = COPY(filename);
-    trace_file->memblocks = NULL;
 
     LOG_TEST_INFO("Trace: %s\n", trace_file->trace_name);
     LOG_TEST_INFO("Operations: %d, Mallocs: %d, Frees: %d, Reallocs: %d\n", trace_file->num_reqs, trace_file->num_ids, num_frees, num_reallocs);
 
-    // read the traces
+    // read the traces, line by line with the parser of the streamed traces. the rest of the line holding the last count is left to it as a blank line
     trace_req_t *reqs = (trace_req_t *)malloc(num_reqs * sizeof(trace_req_t));
     ASSERT_MALLOC(reqs);
 
-    int id = 0;
-    int size = 0;
-
-    char op[MAX_STRING_LENGTH];
+    int max_id = -1;
+    int max_thread = 0;
     int op_idx = 0;
+    int line_number = 3;
+    char line[MAX_STRING_LENGTH];
 
-    while (fscanf(fp, "%s", op) != EOF)
+    while (fgets(line, sizeof(line), fp) != NULL)
     {
-        switch (op[0])
-        {
-        case 'M':
-            fscanf(fp, "%d %d", &id, &size);
-            reqs[op_idx].type = MALLOC;
-            reqs[op_idx].id = id;
-            reqs[op_idx].size = size;
-            break;
-
-        case 'F':
-            fscanf(fp, "%d", &id);
-            reqs[op_idx].type = FREE;
-            reqs[op_idx].id = id;
-            reqs[op_idx].size = 0;
-            break;
-
-        case 'R':
-            fscanf(fp, "%d %d", &id, &size);
-            reqs[op_idx].type = REALLOC;
-            reqs[op_idx].id = id;
-            reqs[op_idx].size = size;
-            break;
+        line_number++;
 
-        default:
-            LOG_ERROR("Invalid operation %c in trace file\n", op[0]);
+        trace_req_t request;
+        int result = traceParseLine(line, &request);
+        if (result < 0)
+        {
+            continue;
+        }
+        if (result > 0)
+        {
+            LOG_ERROR("Invalid call on line %d of trace file %s: %s", line_number, filename, line);
             exit(1);
         }
 
-        op_idx++;
-
-        if (op_idx > num_reqs)
+        if (op_idx >= num_reqs)
         {
             LOG_ERROR("Number of operations in trace file is greater than the number of operations specified in the header\n");
             exit(1);
         }
+        reqs[op_idx++] = request;
+        max_id = MAX(max_id, request.id);
+        max_thread = MAX(max_thread, request.thread);
     }
 
     if (op_idx < num_reqs)
@@ -489,47 +917,178 @@ trace_file_t *parseTraceFile(char *filename)
     }
 
     trace_file->reqs = reqs;
+    trace_file->map_size = 0;
+    trace_file->num_threads = max_thread + 1;
+    initMemBlocks(&trace_file->memblocks, max_id + 1);
+
+    // number the calls on every id, for the handoff between threads
+    int *seqs = (int *)calloc(max_id + 1, sizeof(int));
+    ASSERT_MALLOC(seqs);
+    for (int i = 0; i < num_reqs; i++)
+    {
+        reqs[i].seq = seqs[reqs[i].id]++;
+    }
+    free(seqs);
+
+    if (trace_file->num_threads > 1)
+    {
+        LOG_TEST_INFO("Threads: %d\n", trace_file->num_threads);
+    }
 
     fclose(fp);
 
     return trace_file;
 }
 
-void dumpHex(const char *ptr, size_t size, int index)
+// maps a binary trace written by trace_convert. the records are used in place as the trace's request array, they are only checked against the checksum
+trace_file_t *mapTraceFile(const char *path, char *filename)
 {
-    if (ptr == NULL || size == 0)
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trace_binary_header_t))
     {
-        LOG_ERROR("Invalid arena.\n");
-        return;
+        LOG_ERROR("Error opening binary trace file %s. EXITING TEST PROGRAM.\n", filename);
+        exit(1);
     }
 
-    int dumpSize = (size < 50) ? size : 21; // Either dump the entire arena or 21 bytes around the index
-    int start = dumpSize == size ? 0 : ((index - 10 < 0) ? 0 : index - 10);
-    int end = dumpSize == size ? size : ((index + 10 >= size) ? size : index + 10);
+    char *map = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        LOG_ERROR("Error mapping binary trace file %s. EXITING TEST PROGRAM.\n", filename);
+        exit(1);
+    }
 
-    if (start != 0)
+    trace_binary_header_t *header = (trace_binary_header_t *)map;
+    trace_req_t *reqs = (trace_req_t *)(map + sizeof(trace_binary_header_t));
+
+    if (header->version != TRACE_BINARY_VERSION || header->record_size != sizeof(trace_req_t))
     {
-        LOG_OUT("...\n");
+        LOG_ERROR("Binary trace %s has version %u with %u byte records, this driver reads version %d with %zu byte records. Convert it again.\n",
+                  filename, header->version, header->record_size, TRACE_BINARY_VERSION, sizeof(trace_req_t));
+        exit(1);
     }
-    for (int i = start; i < end; i++)
+
+    if (header->num_reqs > INT32_MAX || (size_t)st.st_size != sizeof(trace_binary_header_t) + header->num_reqs * sizeof(trace_req_t))
     {
-        if (i == index)
-        {
-            // Print the current index in red
-            LOG_COLORED(LOG_BOLDRED, "%02x ", (unsigned char)ptr[i]);
-        }
-        else
-        {
-            LOG_COLORED(LOG_WHITE, "%02x ", (unsigned char)ptr[i]);
-        }
+        LOG_ERROR("Binary trace %s is truncated or corrupt\n", filename);
+        exit(1);
+    }
 
-        if ((i + 1) % 8 == 0)
-        {
-            LOG_OUT(" ");
-        }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    if (traceChecksum(TRACE_CHECKSUM_INIT, reqs, header->num_reqs * sizeof(trace_req_t)) != header->checksum)
+    {
+        LOG_ERROR("Checksum mismatch in binary trace %s\n", filename);
+        exit(1);
+    }
 
-        if ((i + 1) % 16 == 0 || i == end - 1)
-        {
+    trace_file_t *trace_file = (trace_file_t *)malloc(sizeof(trace_file_t));
+    ASSERT_MALLOC(trace_file);
+
+    trace_file->num_ids = header->num_mallocs;
+    trace_file->num_reqs = header->num_reqs;
+    trace_file->num_threads = header->num_threads;
+    trace_file->trace_name = COPY(filename);
+    trace_file->reqs = reqs;
+    trace_file->map_size = st.st_size;
+
+    LOG_TEST_INFO("Trace: %s (binary)\n", trace_file->trace_name);
+    LOG_TEST_INFO("Operations: %d, Mallocs: %lu, Frees: %lu, Reallocs: %lu\n", trace_file->num_reqs, header->num_mallocs, header->num_frees, header->num_reallocs);
+    if (trace_file->num_threads > 1)
+    {
+        LOG_TEST_INFO("Threads: %d\n", trace_file->num_threads);
+    }
+
+    initMemBlocks(&trace_file->memblocks, header->max_id + 1);
+
+    return trace_file;
+}
+
+// sets up a trace to be streamed by runTrace. nothing is read yet, the counts of the trace are known once it has been replayed
+trace_file_t *streamTraceFile(char *filename)
+{
+    char path[MAX_STRING_LENGTH];
+    snprintf(path, sizeof(path), "%s%s", TRACE_PATH, filename);
+
+    if (access(path, R_OK) != 0)
+    {
+        LOG_ERROR("Error opening trace file %s. EXITING TEST PROGRAM.\n", filename);
+        exit(1);
+    }
+
+    trace_file_t *trace_file = (trace_file_t *)malloc(sizeof(trace_file_t));
+    ASSERT_MALLOC(trace_file);
+
+    trace_file->num_ids = 0;
+    trace_file->num_reqs = 0;
+    trace_file->num_threads = 1;
+    trace_file->trace_name = COPY(filename);
+    trace_file->reqs = NULL;
+    trace_file->map_size = 0;
+    initMemBlocks(&trace_file->memblocks, STREAM_CHUNK_REQS);
+
+    LOG_TEST_INFO("Trace: %s (streamed)\n", trace_file->trace_name);
+
+    return trace_file;
+}
+
+// releases the calls of a trace, which are only needed while it is replayed: the mapping of a binary trace or the array parsed from a text one
+void releaseTraceCalls(trace_file_t *trace_file)
+{
+    if (trace_file->map_size > 0)
+    {
+        munmap((char *)trace_file->reqs - sizeof(trace_binary_header_t), trace_file->map_size);
+    }
+    else
+    {
+        free(trace_file->reqs);
+    }
+    trace_file->reqs = NULL;
+    trace_file->map_size = 0;
+}
+
+void cleanUpTrace(trace_file_t *trace_file)
+{
+    releaseTraceCalls(trace_file);
+    free(trace_file->trace_name);
+    free(trace_file);
+}
+
+void dumpHex(const char *ptr, size_t size, int index)
+{
+    if (ptr == NULL || size == 0)
+    {
+        LOG_ERROR("Invalid arena.\n");
+        return;
+    }
+
+    int dumpSize = (size < 50) ? size : 21; // Either dump the entire arena or 21 bytes around the index
+    int start = dumpSize == size ? 0 : ((index - 10 < 0) ? 0 : index - 10);
+    int end = dumpSize == size ? size : ((index + 10 >= size) ? size : index + 10);
+
+    if (start != 0)
+    {
+        LOG_OUT("...\n");
+    }
+    for (int i = start; i < end; i++)
+    {
+        if (i == index)
+        {
+            // Print the current index in red
+            LOG_COLORED(LOG_BOLDRED, "%02x ", (unsigned char)ptr[i]);
+        }
+        else
+        {
+            LOG_COLORED(LOG_WHITE, "%02x ", (unsigned char)ptr[i]);
+        }
+
+        if ((i + 1) % 8 == 0)
+        {
+            LOG_OUT(" ");
+        }
+
+        if ((i + 1) % 16 == 0 || i == end - 1)
+        {
             if (i == end - 1)
             {
                 int remainingSpaces = 16 - ((i + 1) % 16);
@@ -555,273 +1114,1368 @@ int runTrace(trace_file_t *trace_file)
         return 1;
     }
 
-    // initialize the heap
-    if (!EVAL_LIBC)
+    if (trace_file->reqs == NULL)
     {
-        cm_reset_heap();
-        mm_init();
+        return runStreamedTrace(trace_file);
+    }
+
+    if (trace_file->num_threads > 1)
+    {
+        return runThreadedTrace(trace_file);
     }
 
+    // initialize the heap
+    resetHeap();
+
+    int heap_map_fd = openHeapMap(trace_file);
+
     // run the trace
     for (int i = 0; i < trace_file->num_reqs; i++)
     {
-        trace_req_t request = trace_file->reqs[i];
-        clock_t start, end;
+        if (heap_map_fd >= 0 && i % HEAP_MAP_INTERVAL == 0)
+        {
+            dumpHeapMap(heap_map_fd, i);
+        }
 
-        switch (request.type)
+        if (replayRequest(trace_file, &trace_file->reqs[i], i) != 0)
         {
-        case MALLOC:
-            start = clock();
-            void *ptr = ALLOC_ALLOC(request.size);
-            end = clock();
+            return 1;
+        }
+    }
 
-            if (ptr == NULL)
-            {
-                LOG_ERROR("Error allocating memory\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
+    if (heap_map_fd >= 0)
+    {
+        dumpHeapMap(heap_map_fd, trace_file->num_reqs);
+        close(heap_map_fd);
+    }
 
-            if (addMemBlock(&trace_file->memblocks, ptr, request.size, request.id) != 0)
-            {
-                LOG_ERROR("Error adding memory block\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
+    finishTrace(trace_file);
+    return 0;
+}
 
-            memset(ptr, request.id & 0xFF, request.size);
+// runs a single call of a trace, checks the block it returns and records its latency. returns 1 if the call failed
+int replayRequest(trace_file_t *trace_file, trace_req_t *request, int index)
+{
+    uint64_t start, end;
 
-            trace_file->stats.total_requested_memory += request.size;
-            trace_file->stats.memory_in_use += request.size;
+    switch (request->type)
+    {
+    case MALLOC:
+        start = nowNs();
+        void *ptr = ALLOC_ALLOC(request->size);
+        end = nowNs();
 
-            trace_file->stats.total_malloc_time += ((double)(end - start)) / CLOCKS_PER_SEC;
-            trace_file->stats.ran_mallocs++;
+        if (ptr == NULL)
+        {
+            LOG_ERROR("Error allocating memory\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
 
-            break;
+        if (addMemBlock(&trace_file->memblocks, ptr, request->size, request->id) != 0)
+        {
+            LOG_ERROR("Error adding memory block\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
 
-        case FREE:
-            memblock_node_t *curr = trace_file->memblocks;
-            for (; (curr != NULL && curr->id != request.id); curr = curr->next)
-                ;
-            if (!curr)
-            {
-                LOG_ERROR("No corresponding memory block found for this free call.\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
-            
-            start = clock();
-            ALLOC_FREE(curr->start);
-            end = clock();
+        memset(ptr, request->id & 0xFF, request->size);
 
-            if (removeMemBlock(&trace_file->memblocks, curr->id) != 0)
-            {
-                LOG_ERROR("Failed to remove memory block.\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-            }
+        trace_file->stats.total_requested_memory += request->size;
+        trace_file->stats.memory_in_use += request->size;
 
-            trace_file->stats.memory_in_use -= curr->size;
+        histRecord(&trace_file->stats.malloc_latency, elapsedNs(start, end));
 
-            trace_file->stats.total_free_time += ((double)(end - start)) / CLOCKS_PER_SEC;
-            trace_file->stats.ran_frees++;
+        break;
 
-            break;
+    case FREE:
+        memblock_t *curr = findMemBlock(&trace_file->memblocks, request->id);
+        if (!curr)
+        {
+            LOG_ERROR("No corresponding memory block found for this free call.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
+        
+        start = nowNs();
+        ALLOC_FREE(curr->start);
+        end = nowNs();
 
-        case REALLOC:
-            curr = trace_file->memblocks;
-            for (; (curr != NULL && curr->id != request.id); curr = curr->next)
-                ;
-            if (!curr)
-            {
-                LOG_ERROR("No corresponding memory block found for this realloc call.\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
+        if (removeMemBlock(&trace_file->memblocks, request->id) != 0)
+        {
+            LOG_ERROR("Failed to remove memory block.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+        }
 
-            int old_size = curr->size;
-            char *old_ptr = curr->start;
+        trace_file->stats.memory_in_use -= curr->size;
 
-            if (removeMemBlock(&trace_file->memblocks, curr->id) != 0)
-            {
-                LOG_ERROR("Failed to remove memory block.\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-            }
+        histRecord(&trace_file->stats.free_latency, elapsedNs(start, end));
 
-            start = clock();
-            char *test = ALLOC_REALLOC(old_ptr, request.size);
-            end = clock();
+        break;
 
-            if (test == NULL)
-            {
-                LOG_ERROR("Error reallocating memory\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
+    case REALLOC:
+        curr = findMemBlock(&trace_file->memblocks, request->id);
+        if (!curr)
+        {
+            LOG_ERROR("No corresponding memory block found for this realloc call.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
 
-            if (addMemBlock(&trace_file->memblocks, test, request.size, request.id) != 0)
-            {
-                LOG_ERROR("Error adding memory block\n");
-                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
-                return 1;
-            }
+        int old_size = curr->size;
+        char *old_ptr = curr->start;
+
+        if (removeMemBlock(&trace_file->memblocks, request->id) != 0)
+        {
+            LOG_ERROR("Failed to remove memory block.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+        }
+
+        start = nowNs();
+        char *test = ALLOC_REALLOC(old_ptr, request->size);
+        end = nowNs();
+
+        if (test == NULL)
+        {
+            LOG_ERROR("Error reallocating memory\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
 
-            // check for whether contents were preserved
-            for (int i = 0; i < MIN(old_size, request.size); i++)
+        if (addMemBlock(&trace_file->memblocks, test, request->size, request->id) != 0)
+        {
+            LOG_ERROR("Error adding memory block\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
+            return 1;
+        }
+
+        // check for whether contents were preserved
+        for (int i = 0; i < MIN(old_size, request->size); i++)
+        {
+            if (test[i] != (char)(request->id & 0xFF))
             {
-                if (test[i] != (char)(request.id & 0xFF))
-                {
-                    LOG_ERROR("Memory contents after realloc weren't preserved.\n");
-                    LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, i, request.size, request.id);
+                LOG_ERROR("Memory contents after realloc weren't preserved.\n");
+                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d\n", trace_file->trace_name, index, request->size, request->id);
 
-                    // dump the memory contents
-                    dumpHex(test, request.size, i);
-                    LOG_DEBUG("Expected: %x, Got: %x\n", request.id % 0xFF, test[i]);
-                    return 1;
-                }
+                // dump the memory contents
+                dumpHex(test, request->size, i);
+                LOG_DEBUG("Expected: %x, Got: %x\n", request->id % 0xFF, test[i]);
+                return 1;
             }
+        }
 
-            memset(test, request.id & 0xFF, request.size);
+        memset(test, request->id & 0xFF, request->size);
 
-            int size_diff = request.size - old_size;
-            trace_file->stats.total_requested_memory += size_diff;
-            trace_file->stats.memory_in_use += size_diff;
+        int size_diff = request->size - old_size;
+        trace_file->stats.total_requested_memory += size_diff;
+        trace_file->stats.memory_in_use += size_diff;
 
-            trace_file->stats.total_realloc_time += ((double)(end - start)) / CLOCKS_PER_SEC;
-            trace_file->stats.ran_reallocs++;
+        histRecord(&trace_file->stats.realloc_latency, elapsedNs(start, end));
 
-            break;
+        break;
 
-        default:
-            break;
-        }
+    default:
+        break;
     }
 
-    trace_file->stats.heap_size = cm_heap_size();
-    LOG_TEST_SUCCESS("Test passed\n");
+    sampleUtilization(trace_file);
     return 0;
 }
 
-int *test_trace_files(char **trace_files, trace_file_t **traces)
+// replays a streamed trace chunk by chunk, the streaming counterpart of runTrace. the block table grows with the largest id seen so far
+int runStreamedTrace(trace_file_t *trace_file)
 {
-    int total_tests = 0;
-    int tests_passed = 0;
+    char path[MAX_STRING_LENGTH];
+    snprintf(path, sizeof(path), "%s%s", TRACE_PATH, trace_file->trace_name);
 
-    for (int i = 0; trace_files[i] != NULL; i++)
+    trace_stream_t stream;
+    if (streamOpen(&stream, path) != 0)
     {
-        char *trace_file = trace_files[i];
-        total_tests++;
+        LOG_ERROR("Error opening trace file %s for streaming\n", trace_file->trace_name);
+        return 1;
+    }
 
-        trace_file_t *trace = parseTraceFile(trace_file);
-        if (trace == NULL)
-        {
-            continue;
-        }
+    resetHeap();
 
-        trace->stats.heap_size = 0;
-        trace->stats.memory_in_use = 0;
-        trace->stats.total_requested_memory = 0;
-        trace->stats.total_free_time = 0;
-        trace->stats.total_malloc_time = 0;
-        trace->stats.total_realloc_time = 0;
-        trace->stats.ran_frees = 0;
-        trace->stats.ran_mallocs = 0;
-        trace->stats.ran_reallocs = 0;
+    int heap_map_fd = openHeapMap(trace_file);
+    int result = 0;
+    int index = 0;
 
-        if (!EVAL_LIBC)
+    trace_req_t *reqs;
+    int num_reqs;
+    while (result == 0 && (num_reqs = streamNext(&stream, &reqs)) > 0)
+    {
+        for (int i = 0; i < num_reqs && result == 0; i++, index++)
         {
-            cm_init_memory();
-        }
+            if (heap_map_fd >= 0 && index % HEAP_MAP_INTERVAL == 0)
+            {
+                dumpHeapMap(heap_map_fd, index);
+            }
 
-        if (runTrace(trace) != 0)
-        {
-            LOG_TEST_FAIL("Test failed.\n");
-            cm_free_memory();
-            continue;
+            if (reqs[i].id >= trace_file->memblocks.num_blocks)
+            {
+                growMemBlocks(&trace_file->memblocks, MAX(reqs[i].id + 1, trace_file->memblocks.num_blocks * 2));
+            }
+
+            trace_file->num_threads = MAX(trace_file->num_threads, reqs[i].thread + 1);
+            result = replayRequest(trace_file, &reqs[i], index);
         }
+    }
+    trace_file->num_reqs = index;
 
-        tests_passed++;
-        traces[i] = trace;
+    if (stream.error_line)
+    {
+        LOG_ERROR("Invalid call on line %ld of trace file %s\n", stream.error_line, trace_file->trace_name);
+        result = 1;
+    }
+    else if (stream.corrupt)
+    {
+        LOG_ERROR("Checksum mismatch in binary trace %s\n", trace_file->trace_name);
+        result = 1;
+    }
+    streamClose(&stream);
 
-        if (!EVAL_LIBC)
-        {
-            cm_free_memory();
-        }
+    if (heap_map_fd >= 0)
+    {
+        dumpHeapMap(heap_map_fd, index);
+        close(heap_map_fd);
     }
 
-    int *results = malloc(sizeof(int) * 2);
-    results[0] = tests_passed;
-    results[1] = total_tests;
+    if (result != 0)
+    {
+        return 1;
+    }
 
-    LOG_TEST_RESULT("\n   Tests passed: ", "%d/%d\n", results[0], results[1]);
+    LOG_TEST_INFO("Operations: %d, Mallocs: %lu, Frees: %lu, Reallocs: %lu\n", trace_file->num_reqs, trace_file->stats.malloc_latency.total, trace_file->stats.free_latency.total, trace_file->stats.realloc_latency.total);
+    if (trace_file->num_threads > 1)
+    {
+        LOG_TEST_INFO("The calls of all %d threads were replayed on a single thread\n", trace_file->num_threads);
+    }
 
-    return results;
+    finishTrace(trace_file);
+    return 0;
 }
 
-void printStats(trace_file_t **traces, int num_traces)
+// records the end of trace stats, once all calls of a trace passed
+void finishTrace(trace_file_t *trace_file)
 {
-    if (!EVAL_LIBC)
+    trace_file->stats.heap_size = cm_heap_size();
+    if (BACKEND->get_stats)
+    {
+        trace_file->stats.alloc_stats = BACKEND->get_stats();
+    }
+    if (BACKEND->get_probes)
     {
-        LOG_OUT("------------------------------------------------------------------------------------------------\n");
+        trace_file->stats.has_probes = BACKEND->get_probes(&trace_file->stats.probes) == 0;
+    }
+    LOG_TEST_SUCCESS("Test passed\n");
+}
 
-        LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-15s | %-15s | %-15s | %-15s |\n", "Trace Name", "Requested (kB)", "In Use (kB)", "Heap Size (kB)", "Space Util (%)");
+// updates the peak and time weighted utilization metrics, called after every operation of runTrace
+void sampleUtilization(trace_file_t *trace_file)
+{
+    test_stats_t *stats = &trace_file->stats;
+    size_t heap_size = BACKEND->init ? cm_heap_size() : 0;
+    size_t usable_in_use = trace_file->memblocks.usable_in_use;
 
-        LOG_OUT("|----------------------------------------------------------------------------------------------|\n");
+    stats->peak_memory_in_use = MAX(stats->peak_memory_in_use, stats->memory_in_use);
+    stats->peak_heap_size = MAX(stats->peak_heap_size, heap_size);
 
-        for (int i = 0; i < num_traces; i++)
-        {
-            trace_file_t *trace = traces[i];
-            if (!trace)
-                continue;
+    if (heap_size > 0)
+        stats->util_sum += (double)stats->memory_in_use / heap_size;
+    if (usable_in_use > 0)
+        stats->int_frag_sum += 1.0 - (double)stats->memory_in_use / usable_in_use;
 
-            float util = (float)trace->stats.memory_in_use / trace->stats.heap_size;
+    stats->sampled_ops++;
+}
 
-            LOG_OUT("| %-20s | %-15f | %-15f | %-15f | %-15f |\n",
-                    trace->trace_name,
-                    trace->stats.total_requested_memory / 1024.0,
-                    trace->stats.memory_in_use / 1024.0,
-                    trace->stats.heap_size / 1024.0,
-                    util * 100);
-        }
-        LOG_OUT("|----------------------------------------------------------------------------------------------|\n");
-    }
-    else
+// replays a trace that already passed runTrace for throughput. nothing is checked or recorded inside the timed region, and the heap is reused across runs so that only the first warmup run is cold.
+int benchTrace(trace_file_t *trace_file)
+{
+    int num_blocks = trace_file->memblocks.num_blocks;
+
+    void **ptrs = (void **)calloc(num_blocks, sizeof(void *));
+    ASSERT_MALLOC(ptrs);
+    double *throughputs = (double *)malloc(BENCH_REPETITIONS * sizeof(double));
+    ASSERT_MALLOC(throughputs);
+
+    // the counters are opened once, and only enabled around the timed repetitions
+    perf_counters_t counters;
+    if (PERF_MODE)
     {
-        LOG_OUT("|----------------------------------------------------------------------------|\n");
+        perfOpen(&counters);
     }
 
-    LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-15s | %-15s | %-15s |\n", "Trace Name", "Avg. mlc (ms)", "Avg. realc (ms)", "Avg. free (ms)");
-    LOG_OUT("|----------------------------------------------------------------------------|\n");
-
-    for (int i = 0; i < num_traces; i++)
+    for (int run = 0; run < BENCH_WARMUP_RUNS + BENCH_REPETITIONS; run++)
     {
-        trace_file_t *trace = traces[i];
-        if (!trace)
-            continue;
+        resetHeap();
+
+        int counted = PERF_MODE && run >= BENCH_WARMUP_RUNS;
+        if (counted)
+        {
+            perfStart(&counters);
+        }
+
+        uint64_t elapsed;
+        if (trace_file->reqs == NULL)
+        {
+            elapsed = replayStream(trace_file, ptrs);
+        }
+        else if (trace_file->num_threads > 1)
+        {
+            elapsed = replayThreads(trace_file, 0, ptrs);
+        }
+        else
+        {
+            elapsed = replayChunk(trace_file->reqs, trace_file->num_reqs, ptrs);
+        }
 
-        float util = (float)trace->stats.memory_in_use / trace->stats.heap_size;
+        if (counted)
+        {
+            perfStop(&counters, &trace_file->stats.perf);
+            trace_file->stats.perf_ops += trace_file->num_reqs;
+        }
 
-        double avg_malloc = trace->stats.total_malloc_time / trace->stats.ran_mallocs;
-        double avg_free = trace->stats.total_free_time / trace->stats.ran_frees;
-        double avg_realloc = trace->stats.total_realloc_time / trace->stats.ran_reallocs;
+        // the simulated heap is reset before the next run, but blocks from other backends have to be given back
+        for (int id = 0; id < num_blocks; id++)
+        {
+            if (!BACKEND->init && ptrs[id] != NULL)
+            {
+                ALLOC_FREE(ptrs[id]);
+            }
+            ptrs[id] = NULL;
+        }
 
-        LOG_OUT("| %-20s | %-15f | %-15f | %-15f |\n",
-                trace->trace_name,
-                avg_malloc * 1000,
-                avg_realloc * 1000,
-                avg_free * 1000);
+        if (run >= BENCH_WARMUP_RUNS)
+        {
+            throughputs[run - BENCH_WARMUP_RUNS] = trace_file->num_reqs / (MAX(elapsed, 1) / 1e9);
+        }
+    }
+
+    double sum = 0;
+    trace_file->stats.bench_min = throughputs[0];
+    trace_file->stats.bench_max = throughputs[0];
+    for (int i = 0; i < BENCH_REPETITIONS; i++)
+    {
+        sum += throughputs[i];
+        trace_file->stats.bench_min = MIN(trace_file->stats.bench_min, throughputs[i]);
+        trace_file->stats.bench_max = MAX(trace_file->stats.bench_max, throughputs[i]);
+    }
+    trace_file->stats.bench_mean = sum / BENCH_REPETITIONS;
+
+    double squares = 0;
+    for (int i = 0; i < BENCH_REPETITIONS; i++)
+    {
+        squares += (throughputs[i] - trace_file->stats.bench_mean) * (throughputs[i] - trace_file->stats.bench_mean);
+    }
+    trace_file->stats.bench_stddev = BENCH_REPETITIONS > 1 ? sqrt(squares / (BENCH_REPETITIONS - 1)) : 0;
+    trace_file->stats.bench_runs = BENCH_REPETITIONS;
+
+    if (PERF_MODE)
+    {
+        // counters may open fine and still never get scheduled, e.g. in a VM without a virtual PMU
+        if (trace_file->stats.perf.available == 0)
+        {
+            LOG_TEST_INFO("Hardware counters unavailable (see /proc/sys/kernel/perf_event_paranoid), only throughput is measured.\n");
+        }
+        perfClose(&counters);
+    }
+
+    free(ptrs);
+    free(throughputs);
+
+    return 0;
+}
+
+// replays calls without any checks, returns the elapsed time in ns
+uint64_t replayChunk(trace_req_t *reqs, int num_reqs, void **ptrs)
+{
+    uint64_t start = nowNs();
+    for (int i = 0; i < num_reqs; i++)
+    {
+        trace_req_t *request = &reqs[i];
+
+        switch (request->type)
+        {
+        case MALLOC:
+            ptrs[request->id] = ALLOC_ALLOC(request->size);
+            break;
+        case FREE:
+            ALLOC_FREE(ptrs[request->id]);
+            ptrs[request->id] = NULL;
+            break;
+        case REALLOC:
+            ptrs[request->id] = ALLOC_REALLOC(ptrs[request->id], request->size);
+            break;
+        }
+    }
+    uint64_t end = nowNs();
+
+    return elapsedNs(start, end);
+}
+
+// replays a streamed trace without any checks. only the replay of the chunks is timed, not the waits for the reader
+uint64_t replayStream(trace_file_t *trace_file, void **ptrs)
+{
+    char path[MAX_STRING_LENGTH];
+    snprintf(path, sizeof(path), "%s%s", TRACE_PATH, trace_file->trace_name);
+
+    trace_stream_t stream;
+    if (streamOpen(&stream, path) != 0)
+    {
+        LOG_ERROR("Error opening trace file %s for streaming\n", trace_file->trace_name);
+        exit(1);
+    }
+
+    uint64_t elapsed = 0;
+    trace_req_t *reqs;
+    int num_reqs;
+    while ((num_reqs = streamNext(&stream, &reqs)) > 0)
+    {
+        elapsed += replayChunk(reqs, num_reqs, ptrs);
+    }
+
+    streamClose(&stream);
+    return elapsed;
+}
+
+// replays a multi threaded trace with every call checked, the multi threaded counterpart of runTrace.
+// heap maps are not written, the heap can't be walked while other threads are allocating.
+int runThreadedTrace(trace_file_t *trace_file)
+{
+    resetHeap();
+
+    if (replayThreads(trace_file, 1, NULL) == 0)
+    {
+        return 1;
+    }
+
+    finishTrace(trace_file);
+    return 0;
+}
+
+// replays every thread's calls of the trace on its own pthread. returns the elapsed time of the replay in ns, or 0 if a call failed.
+// ptrs is the per id pointer array of the unchecked replay, the checked replay uses the block table of the trace.
+uint64_t replayThreads(trace_file_t *trace_file, int checked, void **ptrs)
+{
+    int num_threads = trace_file->num_threads;
+
+    replay_t replay;
+    replay.trace_file = trace_file;
+    replay.checked = checked;
+    replay.ptrs = ptrs;
+    replay.failed = 0;
+    replay.next_seq = (int *)calloc(trace_file->memblocks.num_blocks, sizeof(int));
+    ASSERT_MALLOC(replay.next_seq);
+    pthread_mutex_init(&replay.alloc_lock, NULL);
+    pthread_mutex_init(&replay.check_lock, NULL);
+    pthread_barrier_init(&replay.start, NULL, num_threads + 1);
+
+    replay_thread_t *threads = (replay_thread_t *)calloc(num_threads, sizeof(replay_thread_t));
+    ASSERT_MALLOC(threads);
+
+    // split the trace into the call streams of the threads
+    for (int i = 0; i < trace_file->num_reqs; i++)
+    {
+        threads[trace_file->reqs[i].thread].num_reqs++;
+    }
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads[t].replay = &replay;
+        threads[t].reqs = (int *)malloc(MAX(threads[t].num_reqs, 1) * sizeof(int));
+        ASSERT_MALLOC(threads[t].reqs);
+        threads[t].num_reqs = 0;
+        histInit(&threads[t].malloc_latency);
+        histInit(&threads[t].free_latency);
+        histInit(&threads[t].realloc_latency);
+    }
+    for (int i = 0; i < trace_file->num_reqs; i++)
+    {
+        replay_thread_t *thread = &threads[trace_file->reqs[i].thread];
+        thread->reqs[thread->num_reqs++] = i;
+    }
+
+    for (int t = 0; t < num_threads; t++)
+    {
+        if (pthread_create(&threads[t].handle, NULL, replayThread, &threads[t]) != 0)
+        {
+            LOG_ERROR("Failed to create replay thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&replay.start);
+    uint64_t start = nowNs();
+    for (int t = 0; t < num_threads; t++)
+    {
+        pthread_join(threads[t].handle, NULL);
+    }
+    uint64_t end = nowNs();
+
+    for (int t = 0; t < num_threads; t++)
+    {
+        if (checked)
+        {
+            histMerge(&trace_file->stats.malloc_latency, &threads[t].malloc_latency);
+            histMerge(&trace_file->stats.free_latency, &threads[t].free_latency);
+            histMerge(&trace_file->stats.realloc_latency, &threads[t].realloc_latency);
+        }
+        free(threads[t].reqs);
+    }
+
+    free(threads);
+    free(replay.next_seq);
+    pthread_mutex_destroy(&replay.alloc_lock);
+    pthread_mutex_destroy(&replay.check_lock);
+    pthread_barrier_destroy(&replay.start);
+
+    return replay.failed ? 0 : MAX(elapsedNs(start, end), 1);
+}
+
+void *replayThread(void *arg)
+{
+    replay_thread_t *thread = (replay_thread_t *)arg;
+    replay_t *replay = thread->replay;
+
+    pthread_barrier_wait(&replay->start);
+
+    for (int i = 0; i < thread->num_reqs && !replay->failed; i++)
+    {
+        trace_req_t *request = &replay->trace_file->reqs[thread->reqs[i]];
+
+        // wait for the calls on this id that come earlier in the trace, they may belong to other threads
+        while (__atomic_load_n(&replay->next_seq[request->id], __ATOMIC_ACQUIRE) != request->seq)
+        {
+            if (replay->failed)
+            {
+                return NULL;
+            }
+            sched_yield();
+        }
+
+        if (replayCall(thread, thread->reqs[i]) != 0)
+        {
+            replay->failed = 1;
+            return NULL;
+        }
+
+        __atomic_store_n(&replay->next_seq[request->id], request->seq + 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+#define LOCK_ALLOCATOR(replay)                     \
+    if (!BACKEND->thread_safe)                     \
+        pthread_mutex_lock(&(replay)->alloc_lock);
+#define UNLOCK_ALLOCATOR(replay)                     \
+    if (!BACKEND->thread_safe)                       \
+        pthread_mutex_unlock(&(replay)->alloc_lock);
+
+// runs a single call of a multi threaded trace. the calling thread owns the id while the call runs, so its block can be written without holding a lock.
+// the block table is updated before a block is given back to the allocator and after a new one is received, so that another thread can't be handed the same memory while it is still in the table.
+int replayCall(replay_thread_t *thread, int index)
+{
+    replay_t *replay = thread->replay;
+    trace_file_t *trace_file = replay->trace_file;
+    trace_req_t *request = &trace_file->reqs[index];
+    uint64_t start, end;
+
+    if (!replay->checked)
+    {
+        void **ptr = &replay->ptrs[request->id];
+
+        LOCK_ALLOCATOR(replay);
+        switch (request->type)
+        {
+        case MALLOC:
+            *ptr = ALLOC_ALLOC(request->size);
+            break;
+        case FREE:
+            ALLOC_FREE(*ptr);
+            *ptr = NULL;
+            break;
+        case REALLOC:
+            *ptr = ALLOC_REALLOC(*ptr, request->size);
+            break;
+        }
+        UNLOCK_ALLOCATOR(replay);
+
+        return 0;
+    }
+
+    switch (request->type)
+    {
+    case MALLOC:
+        start = nowNs();
+        LOCK_ALLOCATOR(replay);
+        void *ptr = ALLOC_ALLOC(request->size);
+        UNLOCK_ALLOCATOR(replay);
+        end = nowNs();
+
+        if (ptr == NULL)
+        {
+            LOG_ERROR("Error allocating memory\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+            return 1;
+        }
+
+        pthread_mutex_lock(&replay->check_lock);
+        if (addMemBlock(&trace_file->memblocks, ptr, request->size, request->id) != 0)
+        {
+            pthread_mutex_unlock(&replay->check_lock);
+            LOG_ERROR("Error adding memory block\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Malloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+            return 1;
+        }
+        trace_file->stats.total_requested_memory += request->size;
+        trace_file->stats.memory_in_use += request->size;
+        sampleUtilization(trace_file);
+        pthread_mutex_unlock(&replay->check_lock);
+
+        memset(ptr, request->id & 0xFF, request->size);
+
+        histRecord(&thread->malloc_latency, elapsedNs(start, end));
+        break;
+
+    case FREE:
+        pthread_mutex_lock(&replay->check_lock);
+        memblock_t *curr = findMemBlock(&trace_file->memblocks, request->id);
+        if (!curr)
+        {
+            pthread_mutex_unlock(&replay->check_lock);
+            LOG_ERROR("No corresponding memory block found for this free call.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Free, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->id, request->thread);
+            return 1;
+        }
+        char *old_ptr = curr->start;
+        trace_file->stats.memory_in_use -= curr->size;
+        removeMemBlock(&trace_file->memblocks, request->id);
+        sampleUtilization(trace_file);
+        pthread_mutex_unlock(&replay->check_lock);
+
+        start = nowNs();
+        LOCK_ALLOCATOR(replay);
+        ALLOC_FREE(old_ptr);
+        UNLOCK_ALLOCATOR(replay);
+        end = nowNs();
+
+        histRecord(&thread->free_latency, elapsedNs(start, end));
+        break;
+
+    case REALLOC:
+        pthread_mutex_lock(&replay->check_lock);
+        curr = findMemBlock(&trace_file->memblocks, request->id);
+        if (!curr)
+        {
+            pthread_mutex_unlock(&replay->check_lock);
+            LOG_ERROR("No corresponding memory block found for this realloc call.\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+            return 1;
+        }
+        int old_size = curr->size;
+        old_ptr = curr->start;
+        removeMemBlock(&trace_file->memblocks, request->id);
+        pthread_mutex_unlock(&replay->check_lock);
+
+        start = nowNs();
+        LOCK_ALLOCATOR(replay);
+        char *test = ALLOC_REALLOC(old_ptr, request->size);
+        UNLOCK_ALLOCATOR(replay);
+        end = nowNs();
+
+        if (test == NULL)
+        {
+            LOG_ERROR("Error reallocating memory\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+            return 1;
+        }
+
+        pthread_mutex_lock(&replay->check_lock);
+        if (addMemBlock(&trace_file->memblocks, test, request->size, request->id) != 0)
+        {
+            pthread_mutex_unlock(&replay->check_lock);
+            LOG_ERROR("Error adding memory block\n");
+            LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+            return 1;
+        }
+        int size_diff = request->size - old_size;
+        trace_file->stats.total_requested_memory += size_diff;
+        trace_file->stats.memory_in_use += size_diff;
+        sampleUtilization(trace_file);
+        pthread_mutex_unlock(&replay->check_lock);
+
+        // check for whether contents were preserved
+        for (int i = 0; i < MIN(old_size, request->size); i++)
+        {
+            if (test[i] != (char)(request->id & 0xFF))
+            {
+                LOG_ERROR("Memory contents after realloc weren't preserved.\n");
+                LOG_DEBUG("Trace: %s, Tracenum: %d, Req: Realloc, Size: %d, Id: %d, Thread: %d\n", trace_file->trace_name, index, request->size, request->id, request->thread);
+                return 1;
+            }
+        }
+
+        memset(test, request->id & 0xFF, request->size);
+
+        histRecord(&thread->realloc_latency, elapsedNs(start, end));
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+int *test_trace_files(char **trace_files, trace_file_t **traces)
+{
+    int total_tests = 0;
+    int tests_passed = 0;
+
+    for (int i = 0; trace_files[i] != NULL; i++)
+    {
+        char *trace_file = trace_files[i];
+        total_tests++;
+
+        trace_file_t *trace = STREAM_MODE ? streamTraceFile(trace_file) : parseTraceFile(trace_file);
+        if (trace == NULL)
+        {
+            continue;
+        }
+
+        trace->stats.heap_size = 0;
+        trace->stats.memory_in_use = 0;
+        trace->stats.total_requested_memory = 0;
+        trace->stats.peak_memory_in_use = 0;
+        trace->stats.peak_heap_size = 0;
+        trace->stats.util_sum = 0;
+        trace->stats.int_frag_sum = 0;
+        trace->stats.sampled_ops = 0;
+        histInit(&trace->stats.malloc_latency);
+        histInit(&trace->stats.free_latency);
+        histInit(&trace->stats.realloc_latency);
+        trace->stats.bench_runs = 0;
+        memset(&trace->stats.perf, 0, sizeof(perf_counts_t));
+        trace->stats.perf_ops = 0;
+        memset(&trace->stats.alloc_stats, 0, sizeof(mm_stats_t));
+        trace->stats.has_probes = 0;
+
+        if (BACKEND->init)
+        {
+            cm_init_memory();
+        }
+
+        int result = runTrace(trace);
+
+        if (result == 0 && BENCH_MODE)
+        {
+            benchTrace(trace);
+        }
+
+        // the block table and the calls are only needed while the trace runs
+        cleanupMemBlocks(&trace->memblocks);
+        releaseTraceCalls(trace);
+
+        if (result != 0)
+        {
+            LOG_TEST_FAIL("Test failed.\n");
+            cleanUpTrace(trace);
+            cm_free_memory();
+            continue;
+        }
+
+        tests_passed++;
+        traces[i] = trace;
+
+        if (BACKEND->init)
+        {
+            cm_free_memory();
+        }
+    }
+
+    int *results = malloc(sizeof(int) * 2);
+    results[0] = tests_passed;
+    results[1] = total_tests;
+
+    LOG_TEST_RESULT("\n   Tests passed: ", "%d/%d\n", results[0], results[1]);
+
+    return results;
+}
+
+void printStats(trace_file_t **traces, int num_traces)
+{
+    // space utilization is only known for the backends on the simulated heap
+    if (BACKEND->init)
+    {
+        LOG_OUT("------------------------------------------------------------------------------------------------------------------------------------------------\n");
+
+        // Space Util is at the end of the trace. Peak Util is peak bytes in use over peak heap size, Avg Util and Int Frag (1 - requested / usable bytes) are averaged over all operations
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-15s | %-15s | %-15s | %-15s | %-13s | %-13s | %-13s |\n", "Trace Name", "Requested (kB)", "In Use (kB)", "Heap Size (kB)", "Space Util (%)", "Peak Util (%)", "Avg Util (%)", "Int Frag (%)");
+
+        LOG_OUT("|----------------------------------------------------------------------------------------------------------------------------------------------|\n");
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            trace_file_t *trace = traces[i];
+            if (!trace)
+                continue;
+
+            float util = (float)trace->stats.memory_in_use / trace->stats.heap_size;
+
+            float peak_util = (float)trace->stats.peak_memory_in_use / trace->stats.peak_heap_size;
+            double samples = MAX(trace->stats.sampled_ops, 1);
+
+            LOG_OUT("| %-20s | %-15f | %-15f | %-15f | %-15f | %-13.2f | %-13.2f | %-13.2f |\n",
+                    trace->trace_name,
+                    trace->stats.total_requested_memory / 1024.0,
+                    trace->stats.memory_in_use / 1024.0,
+                    trace->stats.heap_size / 1024.0,
+                    util * 100,
+                    peak_util * 100,
+                    trace->stats.util_sum / samples * 100,
+                    trace->stats.int_frag_sum / samples * 100);
+        }
+        LOG_OUT("|----------------------------------------------------------------------------------------------------------------------------------------------|\n");
+    }
+
+    if (BACKEND->get_stats)
+    {
+        // allocator internal stats, as reported by the backend's get_stats (mm_get_stats for mm_lib) at the end of each trace
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-8s | %-8s | %-8s | %-8s | %-9s | %-6s | %-10s | %-12s |\n", "Trace Name", "Mallocs", "Frees", "Reallocs", "Splits", "Coalesces", "Sbrks", "Free Blks", "Largest (kB)");
+        LOG_OUT("|-------------------------------------------------------------------------------------------------------------------|\n");
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            trace_file_t *trace = traces[i];
+            if (!trace)
+                continue;
+
+            mm_stats_t *alloc_stats = &trace->stats.alloc_stats;
+
+            LOG_OUT("| %-20s | %-8zu | %-8zu | %-8zu | %-8zu | %-9zu | %-6zu | %-10zu | %-12.3f |\n",
+                    trace->trace_name,
+                    alloc_stats->malloc_calls,
+                    alloc_stats->free_calls,
+                    alloc_stats->realloc_calls,
+                    alloc_stats->splits,
+                    alloc_stats->coalesces,
+                    alloc_stats->heap_extensions,
+                    alloc_stats->free_list_length,
+                    alloc_stats->largest_free_block / 1024.0);
+        }
+        LOG_OUT("|-------------------------------------------------------------------------------------------------------------------|\n");
+    }
+
+    int has_probes = 0;
+    for (int i = 0; i < num_traces; i++)
+    {
+        has_probes |= traces[i] && traces[i]->stats.has_probes;
+    }
+    if (has_probes)
+    {
+        // the work done inside the allocator per call, from the log2 histograms of its probes. the percentiles are the upper ends of their buckets
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-14s | %-8s | %-8s | %-8s | %-8s | %-8s | %-8s |\n", "Trace Name", "Probe", "Calls", "Avg", "p50", "p90", "p99", "Max");
+        LOG_OUT("|--------------------------------------------------------------------------------------------------------------|\n");
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            trace_file_t *trace = traces[i];
+            if (!trace || !trace->stats.has_probes)
+                continue;
+
+#define X(name, label, description) printProbeRow(trace->trace_name, label, &trace->stats.probes.name);
+            LIST_OF_MM_PROBES
+#undef X
+        }
+        LOG_OUT("|--------------------------------------------------------------------------------------------------------------|\n");
+    }
+
+    if (!BACKEND->init && !BACKEND->get_stats)
+    {
+        LOG_OUT("|------------------------------------------------------------------------------------------------------------|\n");
+    }
+
+    // per call latencies, measured with a monotonic ns timer with the timer overhead subtracted
+    LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-7s | %-8s | %-10s | %-10s | %-10s | %-10s | %-10s |\n", "Trace Name", "Op", "Count", "Avg (ns)", "p50 (ns)", "p99 (ns)", "p99.9 (ns)", "Max (ns)");
+    LOG_OUT("|------------------------------------------------------------------------------------------------------------|\n");
+
+    for (int i = 0; i < num_traces; i++)
+    {
+        trace_file_t *trace = traces[i];
+        if (!trace)
+            continue;
+
+        printLatencyRow(trace->trace_name, "malloc", &trace->stats.malloc_latency);
+        printLatencyRow(trace->trace_name, "realloc", &trace->stats.realloc_latency);
+        printLatencyRow(trace->trace_name, "free", &trace->stats.free_latency);
+    }
+    LOG_OUT("|------------------------------------------------------------------------------------------------------------|\n");
+
+    if (BENCH_MODE)
+    {
+        // throughput of the untimed-checks replays, across the timed repetitions
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s | %-6s | %-14s | %-12s | %-14s | %-14s |\n", "Trace Name", "Runs", "Mean (ops/s)", "Stddev (%)", "Min (ops/s)", "Max (ops/s)");
+        LOG_OUT("|-------------------------------------------------------------------------------------------------|\n");
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            trace_file_t *trace = traces[i];
+            if (!trace || trace->stats.bench_runs == 0)
+                continue;
+
+            LOG_OUT("| %-20s | %-6d | %-14.0f | %-12.2f | %-14.0f | %-14.0f |\n",
+                    trace->trace_name,
+                    trace->stats.bench_runs,
+                    trace->stats.bench_mean,
+                    100 * trace->stats.bench_stddev / trace->stats.bench_mean,
+                    trace->stats.bench_min,
+                    trace->stats.bench_max);
+        }
+        LOG_OUT("|-------------------------------------------------------------------------------------------------|\n");
+    }
+
+    if (PERF_MODE)
+    {
+        // hardware counts per operation over the timed repetitions, allocator and replay loop together
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s |", "Trace Name");
+        for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+            LOG_COLORED(LOG_BOLDWHITE, " %-10s |", perf_counter_labels[c]);
+        LOG_COLORED(LOG_BOLDWHITE, " %-6s |\n", "IPC");
+        LOG_OUT("|------------------------------------------------------------------------------------------------------------|\n");
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            trace_file_t *trace = traces[i];
+            if (!trace || trace->stats.perf_ops == 0)
+                continue;
+
+            LOG_OUT("| %-20s |", trace->trace_name);
+            for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+            {
+                double per_op = perfPerOp(&trace->stats.perf, c, trace->stats.perf_ops);
+                if (per_op < 0)
+                    LOG_OUT(" %-10s |", "n/a");
+                else
+                    LOG_OUT(" %-10.*f |", per_op < 10 ? 3 : 1, per_op);
+            }
+
+            double cycles = perfPerOp(&trace->stats.perf, PERF_cycles, trace->stats.perf_ops);
+            double instructions = perfPerOp(&trace->stats.perf, PERF_instructions, trace->stats.perf_ops);
+            if (cycles > 0 && instructions >= 0)
+                LOG_OUT(" %-6.2f |\n", instructions / cycles);
+            else
+                LOG_OUT(" %-6s |\n", "n/a");
+        }
+        LOG_OUT("|------------------------------------------------------------------------------------------------------------|\n");
+    }
+}
+
+// prints a row of the latency table. operations that never ran are printed as "-"
+void printLatencyRow(const char *trace_name, const char *op, histogram_t *hist)
+{
+    if (hist->total == 0)
+    {
+        LOG_OUT("| %-20s | %-7s | %-8d | %-10s | %-10s | %-10s | %-10s | %-10s |\n", trace_name, op, 0, "-", "-", "-", "-", "-");
+        return;
+    }
+
+    LOG_OUT("| %-20s | %-7s | %-8lu | %-10.1f | %-10lu | %-10lu | %-10lu | %-10lu |\n",
+            trace_name,
+            op,
+            hist->total,
+            histMean(hist),
+            histPercentile(hist, 50),
+            histPercentile(hist, 99),
+            histPercentile(hist, 99.9),
+            hist->max);
+}
+
+// upper end of the bucket of a probe's histogram that holds the given percentile of its calls
+static size_t probePercentile(mm_probe_t *probe, double percentile)
+{
+    size_t rank = (size_t)(probe->calls * percentile / 100.0);
+    size_t seen = 0;
+    for (int i = 0; i < MM_PROBE_BUCKETS - 1; i++)
+    {
+        seen += probe->buckets[i];
+        if (seen > rank)
+            return MIN(i == 0 ? 0 : ((size_t)1 << i) - 1, probe->max);
+    }
+    return probe->max;
+}
+
+void printProbeRow(const char *trace_name, const char *probe_name, mm_probe_t *probe)
+{
+    if (probe->calls == 0)
+    {
+        LOG_OUT("| %-20s | %-14s | %-8d | %-8s | %-8s | %-8s | %-8s | %-8s |\n", trace_name, probe_name, 0, "-", "-", "-", "-", "-");
+        return;
+    }
+
+    LOG_OUT("| %-20s | %-14s | %-8zu | %-8.2f | %-8zu | %-8zu | %-8zu | %-8zu |\n",
+            trace_name,
+            probe_name,
+            probe->calls,
+            (double)probe->total / probe->calls,
+            probePercentile(probe, 50),
+            probePercentile(probe, 90),
+            probePercentile(probe, 99),
+            probe->max);
+}
+
+double peakUtil(trace_file_t *trace)
+{
+    return trace->stats.peak_heap_size ? (double)trace->stats.peak_memory_in_use / trace->stats.peak_heap_size : 0;
+}
+
+// throughput of the benchmark runs when the driver was run with -b, otherwise derived from the per call latencies of the checked run
+double opsPerSec(trace_file_t *trace)
+{
+    if (trace->stats.bench_runs > 0)
+        return trace->stats.bench_mean;
+
+    uint64_t total_ns = trace->stats.malloc_latency.sum + trace->stats.realloc_latency.sum + trace->stats.free_latency.sum;
+    return total_ns ? trace->num_reqs / (total_ns / 1e9) : 0;
+}
+
+FILE *openResults(void)
+{
+    char path[MAX_STRING_LENGTH];
+    if (RESULTS_OUTPUT)
+        snprintf(path, sizeof(path), "%s", RESULTS_OUTPUT);
+    else
+        snprintf(path, sizeof(path), "%s.%s", RESULTS_PATH, RESULTS_FORMAT);
+
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (fp == NULL)
+    {
+        LOG_ERROR("Failed to open results file %s\n", path);
+        exit(1);
+    }
+
+    // the results are written with fprintf, after the report
+    if (fp == stdout)
+        LOG_FLUSH();
+
+    if (strcmp(RESULTS_FORMAT, "json") == 0)
+    {
+        fprintf(fp, "{\n  \"results\": [");
+    }
+    else
+    {
+        // csv header, the columns come from the same list as the values
+        fprintf(fp, "allocator,scheme,trace");
+#define X(name, format, value) fprintf(fp, "," #name);
+        LIST_OF_METRICS(trace)
+#undef X
+        fprintf(fp, "\n");
+    }
+
+    if (fp != stdout)
+        LOG_TEST_INFO("Writing %s results to %s\n", RESULTS_FORMAT, path);
+    return fp;
+}
+
+void closeResults(FILE *fp)
+{
+    if (strcmp(RESULTS_FORMAT, "json") == 0)
+        fprintf(fp, "\n  ]\n}\n");
+
+    if (fp != stdout)
+        fclose(fp);
+}
+
+// writes one record per trace that passed
+void writeResults(FILE *fp, const char *allocator, const char *scheme, trace_file_t **traces, int num_traces)
+{
+    int json = strcmp(RESULTS_FORMAT, "json") == 0;
+
+    for (int i = 0; i < num_traces; i++)
+    {
+        trace_file_t *trace = traces[i];
+        if (!trace)
+            continue;
+
+        if (json)
+        {
+            fprintf(fp, "%s\n    {\"allocator\": \"%s\", \"scheme\": \"%s\", \"trace\": \"%s\"", results_written ? "," : "", allocator, scheme, trace->trace_name);
+#define X(name, format, value) fprintf(fp, ", \"" #name "\": " format, value);
+            LIST_OF_METRICS(trace)
+#undef X
+            fprintf(fp, "}");
+        }
+        else
+        {
+            fprintf(fp, "%s,%s,%s", allocator, scheme, trace->trace_name);
+#define X(name, format, value) fprintf(fp, "," format, value);
+            LIST_OF_METRICS(trace)
+#undef X
+            fprintf(fp, "\n");
+        }
+
+        results_written = 1;
+    }
+}
+
+// reads the allocator, scheme, trace, ops_per_sec and peak_util columns of a csv results file written with --format=csv
+int loadBaseline(const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        LOG_ERROR("Failed to open baseline file %s\n", filename);
+        return 1;
+    }
+
+    baseline_rows = (baseline_row_t *)malloc(MAX_BASELINE_ROWS * sizeof(baseline_row_t));
+    ASSERT_MALLOC(baseline_rows);
+
+    char line[4 * MAX_STRING_LENGTH];
+    int allocator_col = -1, scheme_col = -1, trace_col = -1, ops_col = -1, util_col = -1;
+
+    if (fgets(line, sizeof(line), fp) == NULL)
+    {
+        LOG_ERROR("Baseline file %s is empty\n", filename);
+        fclose(fp);
+        return 1;
+    }
+
+    int col = 0;
+    for (char *field = strtok(line, ",\n"); field != NULL; field = strtok(NULL, ",\n"), col++)
+    {
+        if (strcmp(field, "allocator") == 0)
+            allocator_col = col;
+        else if (strcmp(field, "scheme") == 0)
+            scheme_col = col;
+        else if (strcmp(field, "trace") == 0)
+            trace_col = col;
+        else if (strcmp(field, "ops_per_sec") == 0)
+            ops_col = col;
+        else if (strcmp(field, "peak_util") == 0)
+            util_col = col;
+    }
+
+    if (scheme_col < 0 || trace_col < 0 || ops_col < 0 || util_col < 0)
+    {
+        LOG_ERROR("Baseline file %s is not a csv results file (see --format=csv)\n", filename);
+        fclose(fp);
+        return 1;
+    }
+
+    while (num_baseline_rows < MAX_BASELINE_ROWS && fgets(line, sizeof(line), fp) != NULL)
+    {
+        baseline_row_t *row = &baseline_rows[num_baseline_rows];
+        snprintf(row->allocator, sizeof(row->allocator), "%s", "mm_lib");
+        col = 0;
+        for (char *field = strtok(line, ",\n"); field != NULL; field = strtok(NULL, ",\n"), col++)
+        {
+            // results written before the backend registry call mm_lib "student"
+            if (col == allocator_col && strcmp(field, "student") != 0)
+                snprintf(row->allocator, sizeof(row->allocator), "%s", field);
+            else if (col == scheme_col)
+                snprintf(row->scheme, sizeof(row->scheme), "%s", field);
+            else if (col == trace_col)
+                snprintf(row->trace_name, sizeof(row->trace_name), "%s", field);
+            else if (col == ops_col)
+                row->ops_per_sec = atof(field);
+            else if (col == util_col)
+                row->peak_util = atof(field);
+        }
+        num_baseline_rows++;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// compares the gated metrics of every trace against the baseline. returns 1 if any of them regressed past the tolerance, or if a trace of the baseline
+// failed or wasn't run, which would otherwise pass unnoticed
+int compareBaseline(const char *allocator, const char *scheme, char **trace_files, trace_file_t **traces, int num_traces)
+{
+    int regressed = 0;
+    double allowed = 1.0 - BASELINE_TOLERANCE / 100.0;
+
+    LOG_COLORED(LOG_BOLDWHITE, "| %-10s | %-10s | %-20s | %-12s | %-14s | %-14s | %-10s |\n", "Allocator", "Scheme", "Trace Name", "Metric", "Baseline", "Current", "Change (%)");
+    LOG_OUT("|---------------------------------------------------------------------------------------------------------------|\n");
+
+    for (int i = 0; i < num_traces; i++)
+    {
+        trace_file_t *trace = traces[i];
+
+        baseline_row_t *row = NULL;
+        for (int j = 0; j < num_baseline_rows && row == NULL; j++)
+        {
+            if (strcmp(baseline_rows[j].allocator, allocator) == 0 && strcmp(baseline_rows[j].scheme, scheme) == 0 && strcmp(baseline_rows[j].trace_name, trace_files[i]) == 0)
+                row = &baseline_rows[j];
+        }
+
+        if (row == NULL)
+        {
+            LOG_OUT("| %-10s | %-10s | %-20s | %-12s | %-14s | %-14s | %-10s |\n", allocator, scheme, trace_files[i], "-", "no baseline", trace ? "-" : "failed", "-");
+            continue;
+        }
+
+        if (!trace)
+        {
+            LOG_COLORED(LOG_BOLDRED, "| %-10s | %-10s | %-20s | %-12s | %-14s | %-14s | %-10s |\n", allocator, scheme, trace_files[i], "-", "passed", "failed", "-");
+            regressed = 1;
+            continue;
+        }
+
+        const char *metrics[] = {"ops_per_sec", "peak_util"};
+        double baseline_values[] = {row->ops_per_sec, row->peak_util};
+        double current_values[] = {opsPerSec(trace), peakUtil(trace)};
+
+        for (int m = 0; m < 2; m++)
+        {
+            double change = baseline_values[m] ? 100.0 * (current_values[m] - baseline_values[m]) / baseline_values[m] : 0;
+            int is_regression = current_values[m] < baseline_values[m] * allowed;
+
+            LOG_COLORED(is_regression ? LOG_BOLDRED : LOG_RESET, "| %-10s | %-10s | %-20s | %-12s | %-14.4f | %-14.4f | %-10.2f |\n",
+                        allocator, scheme, trace->trace_name, metrics[m], baseline_values[m], current_values[m], change);
+
+            regressed |= is_regression;
+        }
+    }
+
+    for (int j = 0; j < num_baseline_rows; j++)
+    {
+        if (strcmp(baseline_rows[j].allocator, allocator) != 0 || strcmp(baseline_rows[j].scheme, scheme) != 0)
+            continue;
+
+        int was_run = 0;
+        for (int i = 0; i < num_traces && !was_run; i++)
+            was_run = strcmp(baseline_rows[j].trace_name, trace_files[i]) == 0;
+        if (!was_run)
+        {
+            LOG_COLORED(LOG_BOLDRED, "| %-10s | %-10s | %-20s | %-12s | %-14s | %-14s | %-10s |\n", allocator, scheme, baseline_rows[j].trace_name, "-", "passed", "not run", "-");
+            regressed = 1;
+        }
+    }
+    LOG_OUT("|---------------------------------------------------------------------------------------------------------------|\n");
+
+    return regressed;
+}
+
+// prints throughput, average call latency and peak utilization of every trace with one column per backend and scheme
+void printMatrix(run_t *runs, int num_runs, char **trace_files, int num_traces)
+{
+    const char *metrics[] = {"Throughput (ops/s)", "Avg Latency (ns/op)", "Peak Util (%)"};
+
+    for (int m = 0; m < 3; m++)
+    {
+        NEWLINE;
+        LOG_COLORED(LOG_BOLDGREEN, "%s\n", metrics[m]);
+        LOG_COLORED(LOG_BOLDWHITE, "| %-20s |", "Trace Name");
+        for (int r = 0; r < num_runs; r++)
+        {
+            char column[MAX_STRING_LENGTH];
+            snprintf(column, sizeof(column), "%s/%s", runs[r].backend->name, runs[r].scheme);
+            LOG_COLORED(LOG_BOLDWHITE, " %-22s |", column);
+        }
+        NEWLINE;
+
+        for (int i = 0; i < num_traces; i++)
+        {
+            LOG_OUT("| %-20s |", trace_files[i]);
+            for (int r = 0; r < num_runs; r++)
+            {
+                trace_file_t *trace = runs[r].traces[i];
+                if (!trace)
+                {
+                    LOG_COLORED(LOG_BOLDRED, " %-22s |", "failed");
+                    continue;
+                }
+
+                // the latency is averaged over the checked run of every call, not derived from the throughput
+                uint64_t calls = trace->stats.malloc_latency.total + trace->stats.free_latency.total + trace->stats.realloc_latency.total;
+                uint64_t total_ns = trace->stats.malloc_latency.sum + trace->stats.free_latency.sum + trace->stats.realloc_latency.sum;
+
+                if (m == 0)
+                    LOG_OUT(" %-22.0f |", opsPerSec(trace));
+                else if (m == 1)
+                    LOG_OUT(" %-22.1f |", calls ? (double)total_ns / calls : 0.0);
+                else if (runs[r].backend->init)
+                    LOG_OUT(" %-22.2f |", peakUtil(trace) * 100);
+                else
+                    LOG_OUT(" %-22s |", "-");
+            }
+            NEWLINE;
+        }
+    }
+}
+
+// switches the driver to a backend. the replay loops call it through the ALLOC_ pointers, everything else through BACKEND
+void useBackend(const backend_t *backend)
+{
+    BACKEND = backend;
+    ALLOC_ALLOC = backend->malloc;
+    ALLOC_FREE = backend->free;
+    ALLOC_REALLOC = backend->realloc;
+}
+
+// gives the backend a fresh simulated heap before a trace is replayed. backends without an init function don't use it
+void resetHeap(void)
+{
+    if (BACKEND->init)
+    {
+        cm_reset_heap();
+        BACKEND->init();
+    }
+}
+
+// opens the heap map file for the trace being run with the current search scheme. returns -1 if heap maps are disabled or the file couldn't be opened.
+int openHeapMap(trace_file_t *trace_file)
+{
+    if (HEAP_MAP_INTERVAL <= 0 || !BACKEND->dump_heap_map)
+        return -1;
+
+    char path[MAX_STRING_LENGTH];
+    mkdir(HEAP_MAP_PATH, 0755);
+    snprintf(path, sizeof(path), "%s%s_%s.csv", HEAP_MAP_PATH, getenv(SEARCH_SCHEME_ENV), trace_file->trace_name);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to open heap map file %s\n", path);
+        return -1;
+    }
+
+    LOG_TEST_INFO("Writing heap maps to %s\n", path);
+    return fd;
+}
+
+// writes a single heap map snapshot, preceded by a line with the operation index and the heap size
+void dumpHeapMap(int fd, int op)
+{
+    dprintf(fd, "# op=%d heap=%zu\n", op, cm_heap_size());
+    if (BACKEND->dump_heap_map(fd) != 0)
+    {
+        LOG_ERROR("Failed to write the heap map\n");
     }
-    LOG_OUT("|----------------------------------------------------------------------------|\n");
 }
 
 void usage(void)
 {
-    LOG_COLORED(LOG_BOLDCYAN, "Usage: (driver or make driver ARGS=) [-l] [-v] [-B OR -W OR -F] [-t [trace_file1 [trace_file2 ...]]]\n\n");
+    LOG_COLORED(LOG_BOLDCYAN, "Usage: (driver or make driver ARGS=) [-l OR --backends=B] [-v] [-B OR -W OR -F] [-d N] [-b [-w N] [-r N]] [-p] [-s] [--format=json|csv] [--baseline=file] [-t [trace_file1 [trace_file2 ...]]]\n\n");
     LOG_COLORED(LOG_BOLDCYAN, "Options\n");
     LOG_COLORED(LOG_BOLDCYAN, "\t-h            Print this message and exit.\n");
-    LOG_COLORED(LOG_BOLDCYAN, "\t-l            Run libc malloc. Is used as the standard impl. to verify the validity of trace files.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-l            Run libc malloc. Is used as the standard impl. to verify the validity of trace files. Same as --backends=libc.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t--backends=B  Comma separated backends to run side by side (mm_lib, mm_lib_cpy, libc) or all. Prints a comparison matrix for more than one run.\n");
     LOG_COLORED(LOG_BOLDCYAN, "\t-B            Runs the driver only with the BEST_FIT search scheme.\n");
     LOG_COLORED(LOG_BOLDCYAN, "\t-F            Runs the driver only with the FIRST_FIT search scheme.\n");
     LOG_COLORED(LOG_BOLDCYAN, "\t-W            Runs the driver only with the WORST_FIT search scheme.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-d <N>        Dumps the heap map every N operations to " HEAP_MAP_PATH ". Render them with test/heap_map_render.py.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-b            Benchmarks the throughput of every trace that passed, with no checks in the timed region.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-w <N>        Number of untimed warmup runs in benchmark mode (default 2).\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-r <N>        Number of timed repetitions in benchmark mode (default 10).\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-p            Counts hardware events (cycles, instructions, L1D/LLC/dTLB/branch misses) per operation in benchmark mode. Implies -b.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t-s            Streams the traces in chunks instead of loading them whole, for traces larger than memory.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t--format=F    Also writes all metrics per backend, scheme and trace as json or csv to " RESULTS_PATH ".<format>.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t--output=P    Writes the --format results to P instead, - for stdout.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t--baseline=P  Compares throughput and peak utilization against a csv results file, and exits with 1 on a regression.\n");
+    LOG_COLORED(LOG_BOLDCYAN, "\t--tolerance=T Allowed regression against the baseline in percent (default 5).\n");
     LOG_COLORED(LOG_BOLDCYAN, "\t-t <file(s)>  Use <file(s)> as the trace file(s). This option should come at the end.\n");
     LOG_COLORED(LOG_BOLDCYAN, "\nNote that options specifying the allocator must be used alone. If used together the one at the last trumps all.\n\n");
 }
\ No newline at end of file
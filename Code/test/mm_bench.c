@@ -0,0 +1,478 @@
+#include "utils.h"
+#include "mm_lib.h"
+#include "core_mem.h"
+#include "mm_copy.h"
+#include "histogram.h"
+#include <config.h> // mm_lib's include/config.h, test/config.h is the driver's
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Microbenchmarks of mm_lib. Every kernel isolates one path of mm_lib.c and reports the best ns per call over the repetitions, for each search scheme.
+// They are meant as a quick signal for hot path changes, the traces of the driver remain the reference for the allocator as a whole.
+//   pingpong         malloc and free of the same size back to back, the fast path with an empty free list
+//   lifo, fifo       bursts of same size blocks freed newest first or oldest first, each inserted into the free list and coalesced
+//   ladder           every other block of a burst freed, then a burst of larger blocks that fit none of the holes
+//   realloc          a block grown by doubling its size up to BENCH_REALLOC_MAX
+//   small_huge       many small blocks, then one huge block the free list can't hold
+//   freelist_<N>     malloc/free of a block that fits none of N small holes, so every call walks the whole free list
+//   realloc_big      a BENCH_BIG_SIZE block moved back and forth by realloc, copied with memcpy
+//   realloc_big_ws   the same with a pass over a cache sized working set of the caller after every realloc, which the copy should not evict
+//   memcpy_big_ws    the same copies with plain memcpy between two fixed blocks, the baseline of realloc_big_ws
+//   zero_big         mm_zero of a BENCH_BIG_SIZE block, as done by the preloaded calloc
+//   *_nt             the kernel above with the streaming threshold lowered to BENCH_STREAM_THRESHOLD, so the copies and zeroing use non-temporal stores.
+//                    the default threshold is half the last level cache, above the simulated heap on most machines, so mm_lib never streams otherwise
+//   thrash_packed    BENCH_THREADS threads each incrementing a small object of its own, allocated back to back so that they share cache lines
+//   thrash_lines     the same with MM_LINE_ALIGN=1, every object on cache lines of its own. both are skipped with fewer than 2 CPUs online, which can't show false sharing
+//
+// usage: mm_bench [-r repetitions] [-F | -W | -B] [kernel ...]
+// every kernel is run by default, with every search scheme.
+
+#define SEARCH_SCHEME_ENV "SEARCH_SCHEME"
+#define LINE_ALIGN_ENV "MM_LINE_ALIGN"
+
+#define BENCH_DEFAULT_REPETITIONS 5
+
+// blocks per burst of the lifo, fifo, ladder and small_huge kernels
+#define BENCH_BURST 2048
+#define BENCH_SMALL_SIZE 64
+// blocks freed by the lifo, fifo, ladder and freelist kernels, larger than MM_FASTBIN_MAX_SIZE so that they reach the free list instead of a fast bin
+#define BENCH_HOLE_SIZE (MM_FASTBIN_MAX_SIZE + BENCH_SMALL_SIZE)
+#define BENCH_REALLOC_MAX (1 << 20)
+#define BENCH_HUGE_SIZE (4 << 20)
+
+// moved by the realloc kernels, two of them have to fit in the simulated heap
+#define BENCH_BIG_SIZE (3 << 20)
+// the working set of the caller, kept in the cache between the big copies unless they evict it
+#define BENCH_WORKING_SET (256 << 10)
+// the streaming threshold of the _nt kernels, below BENCH_BIG_SIZE
+#define BENCH_STREAM_THRESHOLD (1 << 20)
+
+#define BENCH_THREADS 4
+
+#define LIST_OF_SCHEMES \
+    X(FIRST_FIT)        \
+    X(WORST_FIT)        \
+    X(BEST_FIT)
+
+typedef struct
+{
+    const char *name;
+    void (*setup)(int param);                  // untimed, NULL if the kernel starts from an empty heap
+    uint64_t (*run)(int rounds, int param);    // returns the number of calls made
+    int rounds;
+    int param;
+    size_t stream_threshold;                   // streaming threshold of mm_copy during the kernel, SIZE_MAX never streams and 0 keeps the default
+    int min_cpus;                              // online CPUs the kernel needs to measure what it is meant to, it is skipped on fewer
+} kernel_t;
+
+static void *blocks[2 * 4096];
+static volatile unsigned char working_set[BENCH_WORKING_SET];
+
+// the placement given by the environment, put back after the kernels that change it
+static char *user_line_align = NULL;
+
+static void *checkedMalloc(size_t size)
+{
+    void *ptr = mm_malloc(size);
+    if (ptr == NULL)
+    {
+        LOG_ERROR("mm_malloc(%zu) failed, the kernel doesn't fit in the simulated heap\n", size);
+        exit(1);
+    }
+    return ptr;
+}
+
+static uint64_t pingPong(int rounds, int param)
+{
+    (void)param;
+    for (int i = 0; i < rounds; i++)
+    {
+        mm_free(checkedMalloc(BENCH_SMALL_SIZE));
+    }
+    return 2 * (uint64_t)rounds;
+}
+
+// param 1 frees the burst newest first, 0 oldest first
+static uint64_t storm(int rounds, int lifo)
+{
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < BENCH_BURST; i++)
+        {
+            blocks[i] = checkedMalloc(BENCH_HOLE_SIZE);
+        }
+        for (int i = 0; i < BENCH_BURST; i++)
+        {
+            mm_free(blocks[lifo ? BENCH_BURST - 1 - i : i]);
+        }
+    }
+    return 2 * (uint64_t)rounds * BENCH_BURST;
+}
+
+static uint64_t ladder(int rounds, int param)
+{
+    (void)param;
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < BENCH_BURST; i++)
+        {
+            blocks[i] = checkedMalloc(BENCH_HOLE_SIZE);
+        }
+        for (int i = 0; i < BENCH_BURST; i += 2)
+        {
+            mm_free(blocks[i]);
+        }
+
+        // the holes are BENCH_HOLE_SIZE bytes, so none of these fits in them
+        for (int i = 0; i < BENCH_BURST / 2; i++)
+        {
+            blocks[BENCH_BURST + i] = checkedMalloc(2 * BENCH_HOLE_SIZE);
+        }
+
+        for (int i = 1; i < BENCH_BURST; i += 2)
+        {
+            mm_free(blocks[i]);
+        }
+        for (int i = 0; i < BENCH_BURST / 2; i++)
+        {
+            mm_free(blocks[BENCH_BURST + i]);
+        }
+    }
+    return 3 * (uint64_t)rounds * BENCH_BURST;
+}
+
+static uint64_t reallocDoubling(int rounds, int param)
+{
+    (void)param;
+    uint64_t calls = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        void *ptr = checkedMalloc(16);
+        for (size_t size = 32; size <= BENCH_REALLOC_MAX; size *= 2)
+        {
+            ptr = mm_realloc(ptr, size);
+            if (ptr == NULL)
+            {
+                LOG_ERROR("mm_realloc(%zu) failed\n", size);
+                exit(1);
+            }
+            calls++;
+        }
+        mm_free(ptr);
+        calls += 2;
+    }
+    return calls;
+}
+
+static uint64_t smallThenHuge(int rounds, int param)
+{
+    (void)param;
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < BENCH_BURST; i++)
+        {
+            blocks[i] = checkedMalloc(BENCH_SMALL_SIZE / 2);
+        }
+        mm_free(checkedMalloc(BENCH_HUGE_SIZE));
+        for (int i = 0; i < BENCH_BURST; i++)
+        {
+            mm_free(blocks[i]);
+        }
+    }
+    return 2 * (uint64_t)rounds * (BENCH_BURST + 1);
+}
+
+// param holes of BENCH_HOLE_SIZE bytes, kept apart by live blocks. run before the timer is started
+static void makeHoles(int holes)
+{
+    for (int i = 0; i < 2 * holes; i++)
+    {
+        blocks[i] = checkedMalloc(BENCH_HOLE_SIZE);
+    }
+    for (int i = 0; i < 2 * holes; i += 2)
+    {
+        mm_free(blocks[i]);
+    }
+}
+
+// the block fits none of the holes of makeHoles, so every malloc walks all of them
+static uint64_t freeListScan(int rounds, int holes)
+{
+    (void)holes;
+    for (int i = 0; i < rounds; i++)
+    {
+        mm_free(checkedMalloc(2 * BENCH_HOLE_SIZE));
+    }
+    return 2 * (uint64_t)rounds;
+}
+
+// reads and writes every cache line of the working set
+static void touchWorkingSet(void)
+{
+    for (size_t i = 0; i < BENCH_WORKING_SET; i += 64)
+    {
+        working_set[i]++;
+    }
+}
+
+// realloc between two sizes one page apart, so that every call allocates a new block and copies the old one.
+// param 1 touches the working set after every call
+static uint64_t reallocBig(int rounds, int touch)
+{
+    void *ptr = checkedMalloc(BENCH_BIG_SIZE);
+    memset(ptr, 1, BENCH_BIG_SIZE);
+
+    for (int i = 0; i < rounds; i++)
+    {
+        ptr = mm_realloc(ptr, BENCH_BIG_SIZE + (i % 2 ? 0 : 4096));
+        if (ptr == NULL)
+        {
+            LOG_ERROR("mm_realloc of a big block failed\n");
+            exit(1);
+        }
+        if (touch)
+        {
+            touchWorkingSet();
+        }
+    }
+    return (uint64_t)rounds;
+}
+
+// the same copies as realloc_big_ws, with memcpy between two fixed blocks
+static uint64_t memcpyBig(int rounds, int param)
+{
+    (void)param;
+    char *a = checkedMalloc(BENCH_BIG_SIZE);
+    char *b = checkedMalloc(BENCH_BIG_SIZE);
+    memset(a, 1, BENCH_BIG_SIZE);
+
+    for (int i = 0; i < rounds; i++)
+    {
+        if (i % 2)
+            memcpy(a, b, BENCH_BIG_SIZE);
+        else
+            memcpy(b, a, BENCH_BIG_SIZE);
+        touchWorkingSet();
+    }
+    return (uint64_t)rounds;
+}
+
+static uint64_t zeroBig(int rounds, int param)
+{
+    (void)param;
+    void *ptr = checkedMalloc(BENCH_BIG_SIZE);
+    for (int i = 0; i < rounds; i++)
+    {
+        mm_zero(ptr, BENCH_BIG_SIZE);
+    }
+    return (uint64_t)rounds;
+}
+
+// the objects of the thrash kernels are allocated before the threads start, mm_lib is not thread safe
+static void allocateThrashObjects(int isolate)
+{
+    setenv(LINE_ALIGN_ENV, isolate ? "1" : "0", 1);
+    cm_reset_heap();
+    mm_init();
+
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        blocks[i] = checkedMalloc(sizeof(long));
+        *(volatile long *)blocks[i] = 0;
+    }
+}
+
+typedef struct
+{
+    volatile long *counter;
+    int rounds;
+} thrash_thread_t;
+
+static void *thrashThread(void *arg)
+{
+    thrash_thread_t *thread = arg;
+    for (int i = 0; i < thread->rounds; i++)
+    {
+        (*thread->counter)++;
+    }
+    return NULL;
+}
+
+static uint64_t thrash(int rounds, int param)
+{
+    (void)param;
+    pthread_t threads[BENCH_THREADS];
+    thrash_thread_t args[BENCH_THREADS];
+
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        args[i] = (thrash_thread_t){(volatile long *)blocks[i], rounds};
+        pthread_create(&threads[i], NULL, thrashThread, &args[i]);
+    }
+    for (int i = 0; i < BENCH_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    return (uint64_t)rounds * BENCH_THREADS;
+}
+
+static void restorePlacement(void)
+{
+    if (user_line_align)
+        setenv(LINE_ALIGN_ENV, user_line_align, 1);
+    else
+        unsetenv(LINE_ALIGN_ENV);
+}
+
+static const kernel_t kernels[] = {
+    {"pingpong", NULL, pingPong, 1000000, 0, 0, 1},
+    {"lifo", NULL, storm, 200, 1, 0, 1},
+    {"fifo", NULL, storm, 200, 0, 0, 1},
+    {"ladder", NULL, ladder, 4, 0, 0, 1},
+    {"realloc", NULL, reallocDoubling, 500, 0, 0, 1},
+    {"small_huge", NULL, smallThenHuge, 20, 0, 0, 1},
+    {"freelist_16", makeHoles, freeListScan, 200000, 16, 0, 1},
+    {"freelist_64", makeHoles, freeListScan, 100000, 64, 0, 1},
+    {"freelist_256", makeHoles, freeListScan, 20000, 256, 0, 1},
+    {"freelist_1024", makeHoles, freeListScan, 2000, 1024, 0, 1},
+    {"freelist_4096", makeHoles, freeListScan, 500, 4096, 0, 1},
+    {"realloc_big", NULL, reallocBig, 100, 0, SIZE_MAX, 1},
+    {"realloc_big_nt", NULL, reallocBig, 100, 0, BENCH_STREAM_THRESHOLD, 1},
+    {"realloc_big_ws", NULL, reallocBig, 100, 1, SIZE_MAX, 1},
+    {"realloc_big_ws_nt", NULL, reallocBig, 100, 1, BENCH_STREAM_THRESHOLD, 1},
+    {"memcpy_big_ws", NULL, memcpyBig, 100, 0, 0, 1},
+    {"zero_big", NULL, zeroBig, 100, 0, SIZE_MAX, 1},
+    {"zero_big_nt", NULL, zeroBig, 100, 0, BENCH_STREAM_THRESHOLD, 1},
+    {"thrash_packed", allocateThrashObjects, thrash, 10000000, 0, 0, 2},
+    {"thrash_lines", allocateThrashObjects, thrash, 10000000, 1, 0, 2},
+};
+
+#define NUM_KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+// best ns per call of the kernel over the repetitions, each on a fresh heap
+static double runKernel(const kernel_t *kernel, int repetitions)
+{
+    double best = 0;
+    for (int repetition = 0; repetition < repetitions; repetition++)
+    {
+        cm_reset_heap();
+        mm_init();
+        if (kernel->setup)
+        {
+            kernel->setup(kernel->param);
+        }
+        if (kernel->stream_threshold)
+        {
+            mm_set_stream_threshold(kernel->stream_threshold);
+        }
+
+        uint64_t start = nowNs();
+        uint64_t calls = kernel->run(kernel->rounds, kernel->param);
+        double ns_per_call = (double)elapsedNs(start, nowNs()) / calls;
+
+        if (repetition == 0 || ns_per_call < best)
+            best = ns_per_call;
+
+        restorePlacement();
+        mm_set_stream_threshold(0);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int repetitions = BENCH_DEFAULT_REPETITIONS;
+    const char *only_scheme = NULL;
+    int num_selected = 0;
+    const char **selected = (const char **)calloc(argc, sizeof(char *));
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            repetitions = atoi(argv[++i]);
+            if (repetitions <= 0)
+            {
+                LOG_ERROR("At least one repetition is needed.\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-F") == 0)
+            only_scheme = "FIRST_FIT";
+        else if (strcmp(argv[i], "-W") == 0)
+            only_scheme = "WORST_FIT";
+        else if (strcmp(argv[i], "-B") == 0)
+            only_scheme = "BEST_FIT";
+        else if (argv[i][0] == '-')
+        {
+            LOG_ERROR("usage: %s [-r repetitions] [-F | -W | -B] [kernel ...]\n", argv[0]);
+            return 1;
+        }
+        else
+            selected[num_selected++] = argv[i];
+    }
+
+    for (int i = 0; i < num_selected; i++)
+    {
+        int found = 0;
+        for (int k = 0; k < NUM_KERNELS; k++)
+            found |= strcmp(selected[i], kernels[k].name) == 0;
+        if (!found)
+        {
+            LOG_ERROR("Unknown kernel %s\n", selected[i]);
+            return 1;
+        }
+    }
+
+    if (getenv(LINE_ALIGN_ENV))
+        user_line_align = strdup(getenv(LINE_ALIGN_ENV));
+
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    calibrateTimer();
+    cm_init_memory();
+
+    LOG_OUT("Best ns per call over %d repetitions, copies and zeroing of %zu bytes or more are streamed (%d in the _nt kernels)\n", repetitions,
+            mm_stream_threshold(), BENCH_STREAM_THRESHOLD);
+    LOG_OUT("| %-17s |", "Kernel");
+#define X(SCHEME)                                                  \
+    if (only_scheme == NULL || strcmp(only_scheme, #SCHEME) == 0)  \
+        LOG_OUT(" %-10s |", #SCHEME);
+    LIST_OF_SCHEMES
+#undef X
+    LOG_OUT("\n");
+
+    for (int k = 0; k < NUM_KERNELS; k++)
+    {
+        int run = num_selected == 0;
+        for (int i = 0; i < num_selected; i++)
+            run |= strcmp(selected[i], kernels[k].name) == 0;
+        if (!run)
+            continue;
+
+        LOG_OUT("| %-17s |", kernels[k].name);
+        if (online_cpus < kernels[k].min_cpus)
+        {
+            LOG_OUT(" skipped, needs %d CPUs and %ld are online\n", kernels[k].min_cpus, online_cpus);
+            continue;
+        }
+#define X(SCHEME)                                                                \
+    if (only_scheme == NULL || strcmp(only_scheme, #SCHEME) == 0)                \
+    {                                                                            \
+        setenv(SEARCH_SCHEME_ENV, #SCHEME, 1);                                   \
+        LOG_OUT(" %-10.1f |", runKernel(&kernels[k], repetitions));              \
+        LOG_FLUSH();                                                             \
+    }
+        LIST_OF_SCHEMES
+#undef X
+        LOG_OUT("\n");
+    }
+
+    cm_free_memory();
+    free(selected);
+    free(user_line_align);
+    return 0;
+}
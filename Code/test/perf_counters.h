@@ -0,0 +1,146 @@
+/**
+ * @file perf_counters.h
+ * @brief Hardware performance counters for the test driver, read with perf_event_open.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Every counter is opened on its own, for the calling thread and the threads it creates afterwards, in user space only.
+ * A counter that can't be opened (no PMU in a VM, perf_event_paranoid too high, an event the CPU doesn't have) is left out, the others still count.
+ * When the kernel multiplexes counters the values are scaled up by time enabled / time running.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PERF_CACHE_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// the counters read around each trace, as X(name, type, config, label)
+#define LIST_OF_PERF_COUNTERS                                                                   \
+    X(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "Cycles")                           \
+    X(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "Instrs")                   \
+    X(l1d_misses, PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D), "L1D Miss")     \
+    X(llc_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC Miss")                   \
+    X(dtlb_misses, PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB), "dTLB Miss")  \
+    X(branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "Br Miss")
+
+typedef enum
+{
+#define X(name, type, config, label) PERF_##name,
+    LIST_OF_PERF_COUNTERS
+#undef X
+    NUM_PERF_COUNTERS
+} perf_counter_t;
+
+typedef struct
+{
+    int fds[NUM_PERF_COUNTERS]; // -1 if the counter couldn't be opened
+} perf_counters_t;
+
+// counts read from a perf_counters_t, accumulated over any number of perfStart/perfStop pairs
+typedef struct
+{
+    uint64_t values[NUM_PERF_COUNTERS];
+    unsigned int available; // bit i is set if counter i was counting
+} perf_counts_t;
+
+static const char *perf_counter_labels[NUM_PERF_COUNTERS] = {
+#define X(name, type, config, label) label,
+    LIST_OF_PERF_COUNTERS
+#undef X
+};
+
+// opens all counters disabled. returns the number of counters that could be opened
+static int perfOpen(perf_counters_t *counters)
+{
+    uint32_t types[NUM_PERF_COUNTERS] = {
+#define X(name, type, config, label) type,
+        LIST_OF_PERF_COUNTERS
+#undef X
+    };
+    uint64_t configs[NUM_PERF_COUNTERS] = {
+#define X(name, type, config, label) config,
+        LIST_OF_PERF_COUNTERS
+#undef X
+    };
+
+    int opened = 0;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.inherit = 1; // threads of multi threaded replays count as well
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fds[i] >= 0)
+            opened++;
+    }
+    return opened;
+}
+
+static void perfClose(perf_counters_t *counters)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
+
+static inline void perfStart(perf_counters_t *counters)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+// stops the counters and adds their values to counts
+static inline void perfStop(perf_counters_t *counters, perf_counts_t *counts)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        uint64_t data[3]; // value, time enabled, time running
+        if (counters->fds[i] < 0 || read(counters->fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+            continue;
+
+        counts->values[i] += data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+        counts->available |= 1u << i;
+    }
+}
+
+// average count per operation, or -1 if the counter wasn't available
+static inline double perfPerOp(const perf_counts_t *counts, int counter, uint64_t ops)
+{
+    if (!(counts->available & (1u << counter)) || ops == 0)
+        return -1;
+    return (double)counts->values[counter] / ops;
+}
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,49 @@
+import os
+import shlex
+import subprocess
+import sys
+import time
+
+# Runs a command once with the libc malloc and once with the allocator preloaded, and compares wall time and max RSS.
+# usage: python3 preload_compare.py <path to libmm_malloc.so> <command> [args...]
+
+def run(command, env):
+    start = time.perf_counter()
+    pid = os.fork()
+    if pid == 0:
+        try:
+            os.execvpe(command[0], command, env)
+        finally:
+            os._exit(127)
+    _, status, usage = os.wait4(pid, 0)
+    wall = time.perf_counter() - start
+    return os.waitstatus_to_exitcode(status), wall, usage.ru_maxrss
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        print("usage: python3 preload_compare.py <libmm_malloc.so> <command> [args...]")
+        sys.exit(1)
+
+    library = os.path.abspath(sys.argv[1])
+    command = sys.argv[2:]
+
+    # the command may come in as a single string from make
+    if len(command) == 1:
+        command = shlex.split(command[0])
+
+    libc_env = dict(os.environ)
+    libc_env.pop("LD_PRELOAD", None)
+    mm_env = dict(libc_env)
+    mm_env["LD_PRELOAD"] = library
+
+    results = {}
+    for name, env in [("libc", libc_env), ("mm_malloc", mm_env)]:
+        code, wall, rss = run(command, env)
+        results[name] = (code, wall, rss)
+
+    print(f"| {'Allocator':<12} | {'Exit code':<10} | {'Wall time (s)':<15} | {'Max RSS (kB)':<15} |")
+    for name, (code, wall, rss) in results.items():
+        print(f"| {name:<12} | {code:<10} | {wall:<15.4f} | {rss:<15} |")
+
+    if any(code != 0 for code, _, _ in results.values()):
+        sys.exit(1)
@@ -51,9 +51,11 @@ void print_underlined(const char *format, ...)
     va_list args;
     va_start(args, format);
 
-    // Print the formatted string
+    // Print the formatted string, through LOG_OUT so that it stays in order with the other messages
+    char formatted[256];
+    vsnprintf(formatted, sizeof(formatted), format, args);
     LOG_OUT("%s", LOG_COLOR_UNDLD);
-    vprintf(format, args);
+    LOG_OUT("%s", formatted);
     NEWLINE;
 
     // Calculate the length of the formatted string
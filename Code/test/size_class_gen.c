@@ -0,0 +1,269 @@
+#include "utils.h"
+#include "trace_format.h"
+
+#include <stdlib.h>
+
+// Picks the size classes of mm_lib from traces and writes them as a header (make size_classes writes include/mm_size_classes.h).
+// The sizes of the malloc and realloc calls of every trace are counted in granules of granule bytes up to max_size. With at most classes classes, the last one
+// ending at max_size, the class boundaries are chosen by dynamic programming so that the bytes lost rounding every request up to its class are the fewest.
+// The header holds the class sizes and a table from granule to class, so a size is mapped to its class with two loads.
+//
+// usage: size_class_gen <output.h> [classes=N] [max_size=B] [granule=B] <trace> ...
+// classes defaults to DEFAULT_CLASSES, max_size (a multiple of granule) to DEFAULT_MAX_SIZE and granule to DEFAULT_GRANULE, the default MM_ALIGNMENT. sizes above max_size are not rounded by mm_lib and not counted here.
+
+#define DEFAULT_CLASSES 32
+#define DEFAULT_MAX_SIZE 1024
+#define DEFAULT_GRANULE 8
+
+// class indices are stored in bytes
+#define MAX_CLASSES 255
+
+// values per line of the generated tables
+#define VALUES_PER_LINE 16
+
+typedef struct
+{
+    int num_classes;
+    int max_size;
+    int granule;
+    int num_granules; // max_size / granule, granule g holds the sizes of (g - 1) * granule + 1 to g * granule bytes
+
+    uint64_t *counts; // calls per granule, 1 to num_granules
+    uint64_t num_calls;
+    uint64_t num_above; // calls above max_size
+
+    int *tops;        // last granule of every class
+    int classes_used; // fewer than num_classes when the traces have fewer distinct sizes
+    uint64_t waste;   // bytes lost to the classes over all counted calls
+} generator_t;
+
+static void *checkedCalloc(size_t count, size_t size)
+{
+    void *ptr = calloc(count, size);
+    if (ptr == NULL)
+    {
+        LOG_ERROR("Error allocating memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void countTrace(generator_t *gen, const char *path)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        LOG_ERROR("Error opening trace file %s\n", path);
+        exit(1);
+    }
+
+    char line[MAX_STRING_LENGTH];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        line_number++;
+
+        trace_req_t request;
+        int result = traceParseLine(line, &request);
+        if (result > 0)
+        {
+            LOG_ERROR("Invalid call on line %d of %s: %s", line_number, path, line);
+            exit(1);
+        }
+        if (result < 0 || request.type == FREE)
+            continue;
+
+        if (request.size > gen->max_size)
+        {
+            gen->num_above++;
+            continue;
+        }
+        // mm_lib hands out a granule for malloc(0)
+        int granule = MAX(1, (request.size + gen->granule - 1) / gen->granule);
+        gen->counts[granule]++;
+        gen->num_calls++;
+    }
+    fclose(in);
+}
+
+// cost[k][b] is the least waste of the calls up to granule b with k classes, the last one ending at b. The waste of a class of granules a + 1 to b is
+// the sum of count[g] * (b - g) granules, taken from prefix sums of the counts and of count[g] * g in O(1), so the search is O(classes * granules^2)
+static void pickClasses(generator_t *gen)
+{
+    int granules = gen->num_granules;
+    int num_classes = MIN(gen->num_classes, granules);
+
+    uint64_t *calls = checkedCalloc(granules + 1, sizeof(uint64_t));
+    uint64_t *weighted = checkedCalloc(granules + 1, sizeof(uint64_t));
+    for (int g = 1; g <= granules; g++)
+    {
+        calls[g] = calls[g - 1] + gen->counts[g];
+        weighted[g] = weighted[g - 1] + gen->counts[g] * g;
+    }
+
+    uint64_t *cost = checkedCalloc((size_t)(num_classes + 1) * (granules + 1), sizeof(uint64_t));
+    int *split = checkedCalloc((size_t)(num_classes + 1) * (granules + 1), sizeof(int));
+#define COST(k, b) cost[(size_t)(k) * (granules + 1) + (b)]
+#define SPLIT(k, b) split[(size_t)(k) * (granules + 1) + (b)]
+
+    for (int b = 1; b <= granules; b++)
+    {
+        COST(1, b) = (uint64_t)b * calls[b] - weighted[b];
+    }
+    for (int k = 2; k <= num_classes; k++)
+    {
+        for (int b = k; b <= granules; b++)
+        {
+            COST(k, b) = UINT64_MAX;
+            for (int a = k - 1; a < b; a++)
+            {
+                uint64_t total = COST(k - 1, a) + (uint64_t)b * (calls[b] - calls[a]) - (weighted[b] - weighted[a]);
+                if (total < COST(k, b))
+                {
+                    COST(k, b) = total;
+                    SPLIT(k, b) = a;
+                }
+            }
+        }
+    }
+
+    // the fewest classes that reach the least waste, extra classes would only split sizes no call asks for
+    int best = 1;
+    for (int k = 2; k <= num_classes; k++)
+    {
+        if (COST(k, granules) < COST(best, granules))
+            best = k;
+    }
+
+    gen->classes_used = best;
+    gen->waste = COST(best, granules) * gen->granule;
+    gen->tops = checkedCalloc(best, sizeof(int));
+    for (int k = best, b = granules; k >= 1; k--)
+    {
+        gen->tops[k - 1] = b;
+        b = SPLIT(k, b);
+    }
+
+#undef COST
+#undef SPLIT
+    free(calls);
+    free(weighted);
+    free(cost);
+    free(split);
+}
+
+static void writeHeader(generator_t *gen, FILE *out, int argc, char *argv[])
+{
+    fprintf(out, "/**\n");
+    fprintf(out, " * @file mm_size_classes.h\n");
+    fprintf(out, " * @brief Size classes of mm_lib, generated by test/size_class_gen.c (make size_classes). Do not edit.\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * generated with:");
+    for (int i = 2; i < argc; i++)
+        fprintf(out, " %s", argv[i]);
+    fprintf(out, "\n");
+    fprintf(out, " * %lu calls up to %d bytes (%lu above), %lu bytes lost to the %d classes (%.2f bytes per call)\n",
+            gen->num_calls, gen->max_size, gen->num_above, gen->waste, gen->classes_used, gen->num_calls ? (double)gen->waste / gen->num_calls : 0.0);
+    fprintf(out, " */\n\n");
+
+    fprintf(out, "#ifndef MM_SIZE_CLASSES_H\n");
+    fprintf(out, "#define MM_SIZE_CLASSES_H\n\n");
+    fprintf(out, "#include <stddef.h>\n");
+    fprintf(out, "#include <stdint.h>\n\n");
+
+    fprintf(out, "// granule of the tables, sizes are counted in multiples of it\n");
+    fprintf(out, "#define MM_SIZE_CLASS_GRANULE %d\n", gen->granule);
+    fprintf(out, "#define MM_NUM_SIZE_CLASSES %d\n", gen->classes_used);
+    fprintf(out, "// the size of the largest class, larger requests are not rounded\n");
+    fprintf(out, "#define MM_SIZE_CLASS_MAX_SIZE %d\n\n", gen->max_size);
+
+    fprintf(out, "static const uint32_t mm_size_class_sizes[MM_NUM_SIZE_CLASSES] = {");
+    for (int k = 0; k < gen->classes_used; k++)
+        fprintf(out, "%s%d%s", k % VALUES_PER_LINE == 0 ? "\n    " : " ", gen->tops[k] * gen->granule, k + 1 < gen->classes_used ? "," : "");
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// class of every granule, indexed by (size + MM_SIZE_CLASS_GRANULE - 1) / MM_SIZE_CLASS_GRANULE\n");
+    fprintf(out, "static const uint8_t mm_size_class_of[MM_SIZE_CLASS_MAX_SIZE / MM_SIZE_CLASS_GRANULE + 1] = {");
+    for (int g = 0, k = 0; g <= gen->num_granules; g++)
+    {
+        if (g > gen->tops[k])
+            k++;
+        fprintf(out, "%s%d%s", g % VALUES_PER_LINE == 0 ? "\n    " : " ", k, g < gen->num_granules ? "," : "");
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// the size of the class of size, which must be at most MM_SIZE_CLASS_MAX_SIZE\n");
+    fprintf(out, "static inline size_t mm_size_class_round(size_t size)\n");
+    fprintf(out, "{\n");
+    fprintf(out, "    return mm_size_class_sizes[mm_size_class_of[(size + MM_SIZE_CLASS_GRANULE - 1) / MM_SIZE_CLASS_GRANULE]];\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "#endif // MM_SIZE_CLASSES_H\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        LOG_ERROR("usage: %s <output.h> [classes=N] [max_size=B] [granule=B] <trace> ...\n", argv[0]);
+        return 1;
+    }
+
+    generator_t gen = {.num_classes = DEFAULT_CLASSES, .max_size = DEFAULT_MAX_SIZE, .granule = DEFAULT_GRANULE};
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], "classes=", 8) == 0)
+            gen.num_classes = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "max_size=", 9) == 0)
+            gen.max_size = atoi(argv[i] + 9);
+        else if (strncmp(argv[i], "granule=", 8) == 0)
+            gen.granule = atoi(argv[i] + 8);
+    }
+    if (gen.num_classes < 1 || gen.num_classes > MAX_CLASSES)
+    {
+        LOG_ERROR("classes must be between 1 and %d\n", MAX_CLASSES);
+        return 1;
+    }
+    if (gen.granule < 1 || gen.max_size < gen.granule || gen.max_size % gen.granule != 0)
+    {
+        LOG_ERROR("max_size must be a multiple of the granule, %d\n", gen.granule);
+        return 1;
+    }
+
+    gen.num_granules = gen.max_size / gen.granule;
+    gen.counts = checkedCalloc(gen.num_granules + 1, sizeof(uint64_t));
+
+    int num_traces = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strchr(argv[i], '=') == NULL)
+        {
+            countTrace(&gen, argv[i]);
+            num_traces++;
+        }
+    }
+    if (num_traces == 0)
+    {
+        LOG_ERROR("No trace files given\n");
+        return 1;
+    }
+
+    pickClasses(&gen);
+
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL)
+    {
+        LOG_ERROR("Error opening output file %s\n", argv[1]);
+        return 1;
+    }
+    writeHeader(&gen, out, argc, argv);
+    fclose(out);
+
+    LOG_OUT("Wrote %d size classes up to %d bytes to %s: %lu calls from %d traces, %.2f bytes lost per call\n",
+            gen.classes_used, gen.max_size, argv[1], gen.num_calls, num_traces, gen.num_calls ? (double)gen.waste / gen.num_calls : 0.0);
+
+    free(gen.counts);
+    free(gen.tops);
+    return 0;
+}
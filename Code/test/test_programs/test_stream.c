@@ -0,0 +1,105 @@
+#include "mm_copy.h"
+#include "utils.h"
+
+#include <stdlib.h>
+
+// checks the output of the streaming copy and zero kernels of mm_copy.c. the default threshold is above any block of the simulated heap, so it is lowered
+// to stream every size: below one loop iteration, unaligned heads and tails, and sizes that are no multiple of the 64 or 128 bytes of a loop iteration
+
+#define MAX_OFFSET 64
+#define MAX_SIZE (1 << 20)
+#define GUARD 0xAA
+
+static unsigned char source[MAX_SIZE + MAX_OFFSET];
+static unsigned char target[MAX_SIZE + 2 * MAX_OFFSET];
+
+static const size_t src_offsets[] = {0, 1, 7, 15, 32};
+
+// the bytes around the block must be left alone
+static int checkGuards(size_t dst_offset, size_t size)
+{
+    for (size_t i = 0; i < dst_offset; i++)
+    {
+        if (target[i] != GUARD)
+            return 0;
+    }
+    for (size_t i = dst_offset + size; i < dst_offset + size + MAX_OFFSET; i++)
+    {
+        if (target[i] != GUARD)
+            return 0;
+    }
+    return 1;
+}
+
+static int checkCopy(size_t dst_offset, size_t src_offset, size_t size)
+{
+    memset(target, GUARD, dst_offset + size + MAX_OFFSET);
+    mm_copy(target + dst_offset, source + src_offset, size);
+    return memcmp(target + dst_offset, source + src_offset, size) == 0 && checkGuards(dst_offset, size);
+}
+
+static int checkZero(size_t dst_offset, size_t size)
+{
+    memset(target, GUARD, dst_offset + size + MAX_OFFSET);
+    mm_zero(target + dst_offset, size);
+    for (size_t i = dst_offset; i < dst_offset + size; i++)
+    {
+        if (target[i] != 0)
+            return 0;
+    }
+    return checkGuards(dst_offset, size);
+}
+
+static int checkSize(size_t size)
+{
+    for (size_t dst_offset = 0; dst_offset < MAX_OFFSET; dst_offset++)
+    {
+        for (size_t i = 0; i < sizeof(src_offsets) / sizeof(src_offsets[0]); i++)
+        {
+            if (!checkCopy(dst_offset, src_offsets[i], size))
+            {
+                LOG_ERROR("mm_copy of %zu bytes to offset %zu from offset %zu is wrong\n", size, dst_offset, src_offsets[i]);
+                return 0;
+            }
+        }
+        if (!checkZero(dst_offset, size))
+        {
+            LOG_ERROR("mm_zero of %zu bytes at offset %zu is wrong\n", size, dst_offset);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main()
+{
+    for (size_t i = 0; i < sizeof(source); i++)
+    {
+        source[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    mm_set_stream_threshold(1);
+
+    int passed = 1;
+    for (size_t size = 0; size <= 512 && passed; size++)
+    {
+        passed = checkSize(size);
+    }
+    for (size_t size = 513; size <= 8192 && passed; size += 61)
+    {
+        passed = checkSize(size);
+    }
+    for (size_t size = MAX_SIZE - 200; size <= MAX_SIZE && passed; size += 67)
+    {
+        passed = checkSize(size);
+    }
+
+    mm_set_stream_threshold(0);
+
+    if (!passed)
+    {
+        return 1;
+    }
+    LOG_PRINT("Streamed copies and zeroing match memcpy and memset\n");
+    return 0;
+}
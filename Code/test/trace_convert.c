@@ -0,0 +1,160 @@
+#include "utils.h"
+#include "trace_format.h"
+
+#include <stdlib.h>
+
+// Converts a text trace into the binary trace format (see trace_format.h) that the driver can mmap.
+// The counts of the text header are not needed, they are taken from the calls themselves. Calls are streamed to the output, only a counter per id is kept in memory.
+// usage: trace_convert <input.trace> [output.bin]
+
+// number of records buffered before they are written, a multiple of 8 bytes so that the checksum can be fed in chunks
+#define RECORD_BUFFER_SIZE 4096
+
+typedef struct
+{
+    int *seqs; // number of calls seen so far per id
+    int num_ids;
+
+    trace_binary_header_t header;
+    trace_req_t buffer[RECORD_BUFFER_SIZE];
+    int buffered;
+
+    FILE *out;
+} converter_t;
+
+static void flushRecords(converter_t *converter)
+{
+    if (converter->buffered == 0)
+        return;
+
+    size_t size = converter->buffered * sizeof(trace_req_t);
+    converter->header.checksum = traceChecksum(converter->header.checksum, converter->buffer, size);
+
+    if (fwrite(converter->buffer, 1, size, converter->out) != size)
+    {
+        LOG_ERROR("Failed to write the binary trace\n");
+        exit(1);
+    }
+    converter->buffered = 0;
+}
+
+static void addRecord(converter_t *converter, trace_req_t *request)
+{
+    // grow the per id counters to fit the id
+    if (request->id >= converter->num_ids)
+    {
+        int num_ids = MAX(request->id + 1, converter->num_ids * 2);
+        converter->seqs = (int *)realloc(converter->seqs, num_ids * sizeof(int));
+        if (converter->seqs == NULL)
+        {
+            LOG_ERROR("Error allocating memory\n");
+            exit(1);
+        }
+        memset(converter->seqs + converter->num_ids, 0, (num_ids - converter->num_ids) * sizeof(int));
+        converter->num_ids = num_ids;
+    }
+
+    request->seq = converter->seqs[request->id]++;
+
+    trace_binary_header_t *header = &converter->header;
+    header->num_reqs++;
+    header->num_mallocs += request->type == MALLOC;
+    header->num_frees += request->type == FREE;
+    header->num_reallocs += request->type == REALLOC;
+    header->max_id = MAX(header->max_id, request->id);
+    header->num_threads = MAX(header->num_threads, request->thread + 1);
+
+    converter->buffer[converter->buffered++] = *request;
+    if (converter->buffered == RECORD_BUFFER_SIZE)
+        flushRecords(converter);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        LOG_ERROR("usage: %s <input.trace> [output.bin]\n", argv[0]);
+        return 1;
+    }
+
+    char output[MAX_STRING_LENGTH];
+    if (argc > 2)
+    {
+        snprintf(output, sizeof(output), "%s", argv[2]);
+    }
+    else
+    {
+        // input.trace -> input.bin
+        snprintf(output, sizeof(output), "%s", argv[1]);
+        char *extension = strrchr(output, '.');
+        if (extension == NULL || strchr(extension, '/') != NULL)
+            extension = output + strlen(output);
+        snprintf(extension, sizeof(output) - (extension - output), ".bin");
+    }
+
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL)
+    {
+        LOG_ERROR("Error opening trace file %s\n", argv[1]);
+        return 1;
+    }
+
+    converter_t *converter = (converter_t *)calloc(1, sizeof(converter_t));
+    if (converter == NULL)
+    {
+        LOG_ERROR("Error allocating memory\n");
+        return 1;
+    }
+
+    converter->out = fopen(output, "wb");
+    if (converter->out == NULL)
+    {
+        LOG_ERROR("Error opening output file %s\n", output);
+        return 1;
+    }
+
+    trace_binary_header_t *header = &converter->header;
+    memcpy(header->magic, TRACE_BINARY_MAGIC, TRACE_BINARY_MAGIC_SIZE);
+    header->version = TRACE_BINARY_VERSION;
+    header->record_size = sizeof(trace_req_t);
+    header->max_id = -1;
+    header->num_threads = 1;
+    header->checksum = TRACE_CHECKSUM_INIT;
+
+    // the header is written once all the counts are known
+    fseek(converter->out, sizeof(trace_binary_header_t), SEEK_SET);
+
+    char line[MAX_STRING_LENGTH];
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        line_number++;
+
+        trace_req_t request;
+        int result = traceParseLine(line, &request);
+        if (result > 0)
+        {
+            LOG_ERROR("Invalid call on line %d of %s: %s", line_number, argv[1], line);
+            return 1;
+        }
+        if (result == 0)
+            addRecord(converter, &request);
+    }
+    flushRecords(converter);
+
+    fseek(converter->out, 0, SEEK_SET);
+    if (fwrite(header, sizeof(trace_binary_header_t), 1, converter->out) != 1 || fclose(converter->out) != 0)
+    {
+        LOG_ERROR("Failed to write the binary trace\n");
+        return 1;
+    }
+    fclose(in);
+
+    LOG_OUT("Converted %s to %s: %lu calls (%lu mallocs, %lu frees, %lu reallocs), %d threads\n",
+            argv[1], output, header->num_reqs, header->num_mallocs, header->num_frees, header->num_reallocs, header->num_threads);
+
+    free(converter->seqs);
+    free(converter);
+    return 0;
+}
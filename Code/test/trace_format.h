@@ -0,0 +1,139 @@
+/**
+ * @file trace_format.h
+ * @brief In memory representation of trace calls, and the binary trace format that maps onto it.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * A binary trace is a trace_binary_header_t followed by num_reqs trace_req_t records, exactly as the driver keeps them in memory (seq already filled in).
+ * The driver mmaps the file and uses the records in place, so loading a trace costs one pass over it for the checksum instead of parsing text.
+ * Binary traces are written by trace_convert (make convert) from text traces, and are only valid on machines with the same endianness.
+ */
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_BINARY_MAGIC "MMTRACEB"
+#define TRACE_BINARY_MAGIC_SIZE 8
+#define TRACE_BINARY_VERSION 1
+
+// the largest number of threads a trace can replay on, thread ids are 0 to MAX_TRACE_THREADS - 1
+#define MAX_TRACE_THREADS 64
+
+// represents a single malloc/free/realloc call, belonging to a unique malloc call.
+typedef struct
+{
+    enum
+    {
+        MALLOC,
+        FREE,
+        REALLOC
+    } type;     // type of request
+    int id;     // id of the malloc call
+    int size;   // size of the malloc/realloc call
+    int thread; // thread that issues the call, 0 for single threaded traces
+    int seq;    // position of the call among the calls on the same id, used to hand ids over between threads
+} trace_req_t;
+
+// the records are stored as is, a change of the layout has to bump TRACE_BINARY_VERSION
+_Static_assert(sizeof(trace_req_t) == 5 * sizeof(int32_t), "trace_req_t is stored in binary traces and must stay packed");
+
+typedef struct
+{
+    char magic[TRACE_BINARY_MAGIC_SIZE]; // TRACE_BINARY_MAGIC, not null terminated
+    uint32_t version;                    // TRACE_BINARY_VERSION
+    uint32_t record_size;                // sizeof(trace_req_t)
+
+    uint64_t num_reqs;
+    uint64_t num_mallocs;
+    uint64_t num_frees;
+    uint64_t num_reallocs;
+
+    int32_t max_id;
+    int32_t num_threads;
+
+    uint64_t checksum; // traceChecksum of the records
+} trace_binary_header_t;
+
+_Static_assert(sizeof(trace_binary_header_t) == 64, "the records of a binary trace start at a 64 byte offset");
+
+#define TRACE_CHECKSUM_INIT 14695981039346656037ull
+#define TRACE_CHECKSUM_PRIME 1099511628211ull
+
+// FNV-1a over 8 byte words instead of bytes, so that checking a large trace runs at memory speed.
+// can be fed in chunks, as long as every chunk but the last is a multiple of 8 bytes long
+static inline uint64_t traceChecksum(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * TRACE_CHECKSUM_PRIME;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * TRACE_CHECKSUM_PRIME;
+    }
+    return hash;
+}
+
+// parses one line of a text trace, "[thread] M id size", "[thread] F id" or "[thread] R id size". seq is left to the caller.
+// anything after the call is ignored, such as the "@<ns>" timestamps written by the recorder (src/recorder/mm_recorder.c)
+// returns 0 for a call, -1 for a line to skip (blank, or one of the counts of the header) and 1 for an invalid line
+static int traceParseLine(const char *line, trace_req_t *request)
+{
+    char *cursor = (char *)line;
+    while (isspace((unsigned char)*cursor))
+        cursor++;
+
+    if (*cursor == '\0')
+        return -1;
+
+    request->thread = 0;
+    if (isdigit((unsigned char)*cursor))
+    {
+        request->thread = (int)strtol(cursor, &cursor, 10);
+        while (isspace((unsigned char)*cursor))
+            cursor++;
+
+        // a lone number is a count of the header, which is not needed to read the trace
+        if (*cursor == '\0')
+            return -1;
+    }
+
+    char op = *cursor++;
+    request->id = (int)strtol(cursor, &cursor, 10);
+    request->size = 0;
+    request->seq = 0;
+
+    switch (op)
+    {
+    case 'M':
+        request->type = MALLOC;
+        request->size = (int)strtol(cursor, &cursor, 10);
+        break;
+    case 'F':
+        request->type = FREE;
+        break;
+    case 'R':
+        request->type = REALLOC;
+        request->size = (int)strtol(cursor, &cursor, 10);
+        break;
+    default:
+        return 1;
+    }
+
+    return request->id < 0 || request->size < 0 || request->thread < 0 || request->thread >= MAX_TRACE_THREADS;
+}
+
+#endif // TRACE_FORMAT_H
@@ -0,0 +1,776 @@
+#include "utils.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Generates phased traces, the workload model of test/traces/trace_config.json entries with "phases". trace_gen.py calls it for those entries.
+// A trace is a sequence of phases over one heap, each making num_operations calls with its own pattern:
+//   ramp, plateau, drop  calls drawn with fixed malloc/free/realloc weights (growing, steady and shrinking heaps), frees and reallocs of random live blocks
+//   lifetime             every block is freed a number of calls after its malloc drawn from a lifetime distribution
+//   lifo, fifo           the blocks of the phase are freed newest first (a stack) or oldest first (a queue)
+//   vector               blocks grown by realloc, multiplying their size by growth up to max_size, then freed and started again
+// Freed ids are handed out again, so that the driver's table stays as small as the peak number of live blocks.
+//
+// usage: trace_gen <output.trace> [key=value ...] [phase=<pattern> [key=value ...]]...
+// keys before the first phase apply to the whole trace: seed, threads, free_at_end, size and lifetime (the defaults of the phases).
+// keys of a phase: ops, size, lifetime, probabilities, realloc_probability, depth, push_probability, count, initial_size, max_size, growth.
+// distributions are written name:param:param, as uniform:a:b, normal:mu:sigma, lognormal:mu:sigma, exponential:lambd or gamma:alpha:beta.
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define MAX_PHASES 256
+
+// the longest line written, "<thread> R <id> <size>\n"
+#define MAX_LINE_LENGTH 64
+
+#define LIST_OF_PATTERNS   \
+    X(RAMP, "ramp")         \
+    X(PLATEAU, "plateau")   \
+    X(DROP, "drop")         \
+    X(LIFETIME, "lifetime") \
+    X(LIFO, "lifo")         \
+    X(FIFO, "fifo")         \
+    X(VECTOR, "vector")
+
+typedef enum
+{
+#define X(name, label) PATTERN_##name,
+    LIST_OF_PATTERNS
+#undef X
+    NUM_PATTERNS
+} pattern_t;
+
+static const char *pattern_labels[NUM_PATTERNS] = {
+#define X(name, label) label,
+    LIST_OF_PATTERNS
+#undef X
+};
+
+// malloc/free/realloc weights of the heap profile phases, used unless the phase sets its own probabilities
+static const double profile_weights[3][3] = {
+    {0.75, 0.25, 0.0}, // ramp
+    {0.5, 0.5, 0.0},   // plateau
+    {0.1, 0.9, 0.0},   // drop
+};
+
+typedef enum
+{
+    DIST_NONE,
+    DIST_UNIFORM,
+    DIST_NORMAL,
+    DIST_LOGNORMAL,
+    DIST_EXPONENTIAL,
+    DIST_GAMMA
+} dist_type_t;
+
+typedef struct
+{
+    dist_type_t type;
+    double params[2];
+} distribution_t;
+
+typedef struct
+{
+    pattern_t pattern;
+    long num_operations;
+    distribution_t size;     // DIST_NONE to use the trace's
+    distribution_t lifetime; // DIST_NONE to use the trace's
+    double probabilities[3]; // all 0 to use the pattern's
+    double realloc_probability;
+    double push_probability;
+    long depth;
+    long count;
+    long initial_size;
+    long max_size;
+    double growth;
+} phase_t;
+
+// a free scheduled by a lifetime, for the block handed out by malloc number serial
+typedef struct
+{
+    uint64_t clock;
+    uint64_t serial;
+    int id;
+} death_t;
+
+// a block held by a lifo/fifo/vector phase
+typedef struct
+{
+    int id;
+    uint64_t serial;
+} held_t;
+
+typedef struct
+{
+    uint64_t rng[4];
+    int has_spare_normal;
+    double spare_normal;
+
+    FILE *out;
+    char buffer[OUTPUT_BUFFER_SIZE];
+    size_t buffered;
+    int num_threads;
+    uint64_t counts[3]; // mallocs, frees, reallocs
+
+    // live blocks, by id. positions[id] is the index of id in live, or -1 if id is free
+    int *live;
+    int num_live;
+    int *positions;
+    long *sizes;
+    uint64_t *serials; // number of the malloc that handed out id
+    int *free_ids;
+    int num_free;
+    int next_id;
+    int num_ids; // capacity of the per id arrays
+    uint64_t num_mallocs;
+
+    // min heap of scheduled frees, by clock
+    death_t *deaths;
+    int num_deaths;
+    int deaths_capacity;
+} generator_t;
+
+// --------- Random numbers ---------
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void seedRandom(generator_t *gen, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        gen->rng[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256**
+static inline uint64_t nextRandom(generator_t *gen)
+{
+    uint64_t *s = gen->rng;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// uniform in [0, 1)
+static inline double randomUnit(generator_t *gen)
+{
+    return (nextRandom(gen) >> 11) * 0x1.0p-53;
+}
+
+// uniform in [0, n)
+static inline uint64_t randomBelow(generator_t *gen, uint64_t n)
+{
+    return (uint64_t)(((unsigned __int128)nextRandom(gen) * n) >> 64);
+}
+
+// standard normal, by the polar method
+static double randomNormal(generator_t *gen)
+{
+    if (gen->has_spare_normal)
+    {
+        gen->has_spare_normal = 0;
+        return gen->spare_normal;
+    }
+
+    double u, v, s;
+    do
+    {
+        u = 2 * randomUnit(gen) - 1;
+        v = 2 * randomUnit(gen) - 1;
+        s = u * u + v * v;
+    } while (s >= 1 || s == 0);
+
+    double scale = sqrt(-2 * log(s) / s);
+    gen->spare_normal = v * scale;
+    gen->has_spare_normal = 1;
+    return u * scale;
+}
+
+// gamma with shape alpha and scale beta, by Marsaglia and Tsang's method
+static double randomGamma(generator_t *gen, double alpha, double beta)
+{
+    if (alpha < 1)
+        return randomGamma(gen, alpha + 1, beta) * pow(1 - randomUnit(gen), 1 / alpha);
+
+    double d = alpha - 1.0 / 3;
+    double c = 1 / sqrt(9 * d);
+    for (;;)
+    {
+        double x = randomNormal(gen);
+        double v = 1 + c * x;
+        if (v <= 0)
+            continue;
+
+        v = v * v * v;
+        double u = 1 - randomUnit(gen);
+        if (log(u) < 0.5 * x * x + d - d * v + d * log(v))
+            return d * v * beta;
+    }
+}
+
+static double sample(generator_t *gen, const distribution_t *dist)
+{
+    switch (dist->type)
+    {
+    case DIST_UNIFORM:
+        return dist->params[0] + (dist->params[1] - dist->params[0]) * randomUnit(gen);
+    case DIST_NORMAL:
+        return dist->params[0] + dist->params[1] * randomNormal(gen);
+    case DIST_LOGNORMAL:
+        return exp(dist->params[0] + dist->params[1] * randomNormal(gen));
+    case DIST_EXPONENTIAL:
+        return -log(1 - randomUnit(gen)) / dist->params[0];
+    case DIST_GAMMA:
+        return randomGamma(gen, dist->params[0], dist->params[1]);
+    default:
+        return 0;
+    }
+}
+
+// sizes are stored as int by the driver
+static inline long clampSize(double size)
+{
+    return size < 1 ? 1 : size > INT_MAX ? INT_MAX : (long)size;
+}
+
+static inline long sampleSize(generator_t *gen, const distribution_t *dist)
+{
+    return clampSize(sample(gen, dist));
+}
+
+// --------- Output ---------
+
+static inline char *writeNumber(char *cursor, unsigned long value)
+{
+    char digits[24];
+    int length = 0;
+    do
+    {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (length)
+        *cursor++ = digits[--length];
+    return cursor;
+}
+
+static void flushOutput(generator_t *gen)
+{
+    if (fwrite(gen->buffer, 1, gen->buffered, gen->out) != gen->buffered)
+    {
+        LOG_ERROR("Failed to write the trace\n");
+        exit(1);
+    }
+    gen->buffered = 0;
+}
+
+// writes "[thread] op id [size]", size < 0 for a free
+static inline void writeCall(generator_t *gen, char op, int id, long size)
+{
+    if (gen->buffered + MAX_LINE_LENGTH > OUTPUT_BUFFER_SIZE)
+        flushOutput(gen);
+
+    char *cursor = gen->buffer + gen->buffered;
+    if (gen->num_threads > 1)
+    {
+        cursor = writeNumber(cursor, randomBelow(gen, gen->num_threads));
+        *cursor++ = ' ';
+    }
+    *cursor++ = op;
+    *cursor++ = ' ';
+    cursor = writeNumber(cursor, id);
+    if (size >= 0)
+    {
+        *cursor++ = ' ';
+        cursor = writeNumber(cursor, size);
+    }
+    *cursor++ = '\n';
+    gen->buffered = cursor - gen->buffer;
+}
+
+// the counts are only known at the end, so the header is written padded to a fixed width and overwritten then
+static void writeHeader(generator_t *gen)
+{
+    uint64_t total = gen->counts[0] + gen->counts[1] + gen->counts[2];
+    fprintf(gen->out, "%-20lu\n%-20lu\n%-20lu\n%-20lu\n", total, gen->counts[0], gen->counts[1], gen->counts[2]);
+}
+
+// --------- Heap ---------
+
+static void *growArray(void *array, size_t count, size_t size)
+{
+    array = realloc(array, count * size);
+    if (array == NULL)
+    {
+        LOG_ERROR("Error allocating memory\n");
+        exit(1);
+    }
+    return array;
+}
+
+static inline uint64_t numCalls(generator_t *gen)
+{
+    return gen->counts[0] + gen->counts[1] + gen->counts[2];
+}
+
+static inline int isLive(generator_t *gen, int id, uint64_t serial)
+{
+    return gen->positions[id] >= 0 && gen->serials[id] == serial;
+}
+
+static int genMalloc(generator_t *gen, long size)
+{
+    int id;
+    if (gen->num_free > 0)
+    {
+        id = gen->free_ids[--gen->num_free];
+    }
+    else
+    {
+        if (gen->next_id == gen->num_ids)
+        {
+            gen->num_ids = MAX(1024, gen->num_ids * 2);
+            gen->live = (int *)growArray(gen->live, gen->num_ids, sizeof(int));
+            gen->positions = (int *)growArray(gen->positions, gen->num_ids, sizeof(int));
+            gen->sizes = (long *)growArray(gen->sizes, gen->num_ids, sizeof(long));
+            gen->serials = (uint64_t *)growArray(gen->serials, gen->num_ids, sizeof(uint64_t));
+            gen->free_ids = (int *)growArray(gen->free_ids, gen->num_ids, sizeof(int));
+        }
+        id = gen->next_id++;
+    }
+
+    gen->positions[id] = gen->num_live;
+    gen->live[gen->num_live++] = id;
+    gen->sizes[id] = size;
+    gen->serials[id] = gen->num_mallocs++;
+
+    writeCall(gen, 'M', id, size);
+    gen->counts[0]++;
+    return id;
+}
+
+static void genFree(generator_t *gen, int id)
+{
+    // move the last live block into the hole
+    int position = gen->positions[id];
+    int last = gen->live[--gen->num_live];
+    gen->live[position] = last;
+    gen->positions[last] = position;
+    gen->positions[id] = -1;
+    gen->free_ids[gen->num_free++] = id;
+
+    writeCall(gen, 'F', id, -1);
+    gen->counts[1]++;
+}
+
+static void genRealloc(generator_t *gen, int id, long size)
+{
+    gen->sizes[id] = size;
+    writeCall(gen, 'R', id, size);
+    gen->counts[2]++;
+}
+
+static inline int randomLive(generator_t *gen)
+{
+    return gen->live[randomBelow(gen, gen->num_live)];
+}
+
+static void pushDeath(generator_t *gen, death_t death)
+{
+    if (gen->num_deaths == gen->deaths_capacity)
+    {
+        gen->deaths_capacity = MAX(1024, gen->deaths_capacity * 2);
+        gen->deaths = (death_t *)growArray(gen->deaths, gen->deaths_capacity, sizeof(death_t));
+    }
+
+    int i = gen->num_deaths++;
+    while (i > 0 && gen->deaths[(i - 1) / 2].clock > death.clock)
+    {
+        gen->deaths[i] = gen->deaths[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    gen->deaths[i] = death;
+}
+
+static death_t popDeath(generator_t *gen)
+{
+    death_t top = gen->deaths[0];
+    death_t last = gen->deaths[--gen->num_deaths];
+
+    int i = 0;
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= gen->num_deaths)
+            break;
+        if (child + 1 < gen->num_deaths && gen->deaths[child + 1].clock < gen->deaths[child].clock)
+            child++;
+        if (gen->deaths[child].clock >= last.clock)
+            break;
+        gen->deaths[i] = gen->deaths[child];
+        i = child;
+    }
+    gen->deaths[i] = last;
+    return top;
+}
+
+// --------- Phases ---------
+
+static void runProfilePhase(generator_t *gen, const phase_t *phase, const distribution_t *size)
+{
+    const double *weights = phase->probabilities;
+    if (weights[0] + weights[1] + weights[2] == 0)
+        weights = profile_weights[phase->pattern - PATTERN_RAMP];
+
+    double total = weights[0] + weights[1] + weights[2];
+    double p_malloc = weights[0] / total;
+    double p_free = p_malloc + weights[1] / total;
+
+    for (long i = 0; i < phase->num_operations; i++)
+    {
+        double r = randomUnit(gen);
+        if (r < p_malloc || gen->num_live == 0)
+            genMalloc(gen, sampleSize(gen, size));
+        else if (r < p_free)
+            genFree(gen, randomLive(gen));
+        else
+            genRealloc(gen, randomLive(gen), sampleSize(gen, size));
+    }
+}
+
+// blocks outliving the phase are freed as soon as the next lifetime phase starts, or stay live
+static void runLifetimePhase(generator_t *gen, const phase_t *phase, const distribution_t *size, const distribution_t *lifetime)
+{
+    uint64_t end = numCalls(gen) + phase->num_operations;
+
+    while (numCalls(gen) < end)
+    {
+        // one due free per call. a block another phase freed already is skipped without a call
+        int freed = 0;
+        while (!freed && gen->num_deaths > 0 && gen->deaths[0].clock <= numCalls(gen))
+        {
+            death_t death = popDeath(gen);
+            if (isLive(gen, death.id, death.serial))
+            {
+                genFree(gen, death.id);
+                freed = 1;
+            }
+        }
+        if (freed)
+            continue;
+
+        if (gen->num_live > 0 && randomUnit(gen) < phase->realloc_probability)
+        {
+            genRealloc(gen, randomLive(gen), sampleSize(gen, size));
+            continue;
+        }
+
+        int id = genMalloc(gen, sampleSize(gen, size));
+        double calls = sample(gen, lifetime);
+        death_t death = {numCalls(gen) + (calls > 0 ? (uint64_t)calls : 0), gen->serials[id], id};
+        pushDeath(gen, death);
+    }
+}
+
+// the number of blocks the phase holds does a random walk between 0 and depth, blocks still held at the end stay live
+static void runQueuePhase(generator_t *gen, const phase_t *phase, const distribution_t *size)
+{
+    long depth = MAX(1, phase->depth);
+    held_t *held = (held_t *)growArray(NULL, depth, sizeof(held_t));
+    long head = 0; // ring buffer of the held blocks, oldest at head
+    long count = 0;
+
+    for (long i = 0; i < phase->num_operations; i++)
+    {
+        if (count > 0 && (count >= depth || randomUnit(gen) >= phase->push_probability))
+        {
+            held_t block;
+            if (phase->pattern == PATTERN_LIFO)
+            {
+                block = held[(head + count - 1) % depth];
+            }
+            else
+            {
+                block = held[head];
+                head = (head + 1) % depth;
+            }
+            count--;
+
+            // a block freed by a lifetime in the meantime is just dropped
+            if (isLive(gen, block.id, block.serial))
+            {
+                genFree(gen, block.id);
+                continue;
+            }
+        }
+
+        int id = genMalloc(gen, sampleSize(gen, size));
+        held[(head + count++) % depth] = (held_t){id, gen->serials[id]};
+    }
+
+    free(held);
+}
+
+static void runVectorPhase(generator_t *gen, const phase_t *phase)
+{
+    long count = MAX(1, phase->count);
+    held_t *vectors = (held_t *)growArray(NULL, count, sizeof(held_t));
+    for (long i = 0; i < count; i++)
+        vectors[i].id = -1;
+
+    for (long i = 0; i < phase->num_operations; i++)
+    {
+        held_t *vector = &vectors[randomBelow(gen, count)];
+
+        if (vector->id < 0 || !isLive(gen, vector->id, vector->serial))
+        {
+            vector->id = genMalloc(gen, clampSize(phase->initial_size));
+            vector->serial = gen->serials[vector->id];
+            continue;
+        }
+
+        double size = gen->sizes[vector->id] * phase->growth;
+        if (size > phase->max_size)
+        {
+            genFree(gen, vector->id);
+            vector->id = -1;
+        }
+        else
+        {
+            genRealloc(gen, vector->id, clampSize(size));
+        }
+    }
+
+    free(vectors);
+}
+
+// --------- Arguments ---------
+
+static int parseDistribution(const char *value, distribution_t *dist)
+{
+    static const struct
+    {
+        const char *name;
+        dist_type_t type;
+    } names[] = {{"uniform", DIST_UNIFORM}, {"normal", DIST_NORMAL}, {"lognormal", DIST_LOGNORMAL}, {"exponential", DIST_EXPONENTIAL}, {"gamma", DIST_GAMMA}};
+
+    size_t length = strcspn(value, ":");
+    dist->type = DIST_NONE;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strlen(names[i].name) == length && strncmp(value, names[i].name, length) == 0)
+            dist->type = names[i].type;
+    }
+
+    char *cursor = (char *)value + length;
+    for (int i = 0; i < 2 && *cursor == ':'; i++)
+        dist->params[i] = strtod(cursor + 1, &cursor);
+
+    return dist->type == DIST_NONE;
+}
+
+static void setDefaults(phase_t *phase)
+{
+    memset(phase, 0, sizeof(phase_t));
+    phase->push_probability = 0.5;
+    phase->depth = 64;
+    phase->count = 1;
+    phase->initial_size = 16;
+    phase->max_size = 1 << 20;
+    phase->growth = 2;
+}
+
+// applies key=value to a phase, or to the trace defaults. returns 0 on success
+static int parseOption(const char *key, const char *value, phase_t *phase)
+{
+    if (strcmp(key, "ops") == 0)
+        phase->num_operations = strtol(value, NULL, 10);
+    else if (strcmp(key, "size") == 0)
+        return parseDistribution(value, &phase->size);
+    else if (strcmp(key, "lifetime") == 0)
+        return parseDistribution(value, &phase->lifetime);
+    else if (strcmp(key, "probabilities") == 0)
+        sscanf(value, "%lf:%lf:%lf", &phase->probabilities[0], &phase->probabilities[1], &phase->probabilities[2]);
+    else if (strcmp(key, "realloc_probability") == 0)
+        phase->realloc_probability = strtod(value, NULL);
+    else if (strcmp(key, "push_probability") == 0)
+        phase->push_probability = strtod(value, NULL);
+    else if (strcmp(key, "depth") == 0)
+        phase->depth = strtol(value, NULL, 10);
+    else if (strcmp(key, "count") == 0)
+        phase->count = strtol(value, NULL, 10);
+    else if (strcmp(key, "initial_size") == 0)
+        phase->initial_size = strtol(value, NULL, 10);
+    else if (strcmp(key, "max_size") == 0)
+        phase->max_size = strtol(value, NULL, 10);
+    else if (strcmp(key, "growth") == 0)
+        phase->growth = strtod(value, NULL);
+    else
+        return 1;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        LOG_ERROR("usage: %s <output.trace> [key=value ...] [phase=<pattern> [key=value ...]]...\n", argv[0]);
+        return 1;
+    }
+
+    generator_t *gen = (generator_t *)calloc(1, sizeof(generator_t));
+    phase_t *phases = (phase_t *)calloc(MAX_PHASES + 1, sizeof(phase_t));
+    if (gen == NULL || phases == NULL)
+    {
+        LOG_ERROR("Error allocating memory\n");
+        return 1;
+    }
+
+    // phases[0] holds the trace defaults
+    phase_t *trace = &phases[0];
+    setDefaults(trace);
+    int num_phases = 0;
+    uint64_t seed = 0;
+    int free_at_end = 0;
+    gen->num_threads = 1;
+
+    for (int i = 2; i < argc; i++)
+    {
+        char key[MAX_STRING_LENGTH];
+        const char *equals = strchr(argv[i], '=');
+        if (equals == NULL || equals - argv[i] >= MAX_STRING_LENGTH)
+        {
+            LOG_ERROR("Invalid argument %s, expected key=value\n", argv[i]);
+            return 1;
+        }
+        snprintf(key, equals - argv[i] + 1, "%s", argv[i]);
+        const char *value = equals + 1;
+
+        int invalid = 0;
+        if (strcmp(key, "phase") == 0)
+        {
+            if (num_phases == MAX_PHASES)
+            {
+                LOG_ERROR("More than %d phases\n", MAX_PHASES);
+                return 1;
+            }
+
+            phase_t *phase = &phases[++num_phases];
+            setDefaults(phase);
+            phase->pattern = NUM_PATTERNS;
+            for (int j = 0; j < NUM_PATTERNS; j++)
+            {
+                if (strcmp(value, pattern_labels[j]) == 0)
+                    phase->pattern = j;
+            }
+            if (strcmp(value, "stack") == 0)
+                phase->pattern = PATTERN_LIFO;
+            invalid = phase->pattern == NUM_PATTERNS;
+        }
+        else if (num_phases == 0 && strcmp(key, "seed") == 0)
+            seed = strtoull(value, NULL, 10);
+        else if (num_phases == 0 && strcmp(key, "threads") == 0)
+            gen->num_threads = MAX(1, atoi(value));
+        else if (num_phases == 0 && strcmp(key, "free_at_end") == 0)
+            free_at_end = atoi(value);
+        else
+            invalid = parseOption(key, value, &phases[num_phases]);
+
+        if (invalid)
+        {
+            LOG_ERROR("Invalid argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    gen->out = fopen(argv[1], "w");
+    if (gen->out == NULL)
+    {
+        LOG_ERROR("Error opening output file %s\n", argv[1]);
+        return 1;
+    }
+
+    seedRandom(gen, seed);
+    writeHeader(gen);
+
+    for (int i = 1; i <= num_phases; i++)
+    {
+        phase_t *phase = &phases[i];
+        const distribution_t *size = phase->size.type != DIST_NONE ? &phase->size : &trace->size;
+        const distribution_t *lifetime = phase->lifetime.type != DIST_NONE ? &phase->lifetime : &trace->lifetime;
+
+        if (size->type == DIST_NONE && phase->pattern != PATTERN_VECTOR)
+        {
+            LOG_ERROR("Phase %d (%s) has no size distribution\n", i, pattern_labels[phase->pattern]);
+            return 1;
+        }
+        if (lifetime->type == DIST_NONE && phase->pattern == PATTERN_LIFETIME)
+        {
+            LOG_ERROR("Phase %d (lifetime) has no lifetime distribution\n", i);
+            return 1;
+        }
+
+        switch (phase->pattern)
+        {
+        case PATTERN_RAMP:
+        case PATTERN_PLATEAU:
+        case PATTERN_DROP:
+            runProfilePhase(gen, phase, size);
+            break;
+        case PATTERN_LIFETIME:
+            runLifetimePhase(gen, phase, size, lifetime);
+            break;
+        case PATTERN_LIFO:
+        case PATTERN_FIFO:
+            runQueuePhase(gen, phase, size);
+            break;
+        case PATTERN_VECTOR:
+            runVectorPhase(gen, phase);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // frees whatever is still live, so that the trace ends with an empty heap
+    while (free_at_end && gen->num_live > 0)
+        genFree(gen, gen->live[gen->num_live - 1]);
+
+    flushOutput(gen);
+    rewind(gen->out);
+    writeHeader(gen);
+    if (fclose(gen->out) != 0)
+    {
+        LOG_ERROR("Failed to write the trace\n");
+        return 1;
+    }
+
+    LOG_OUT("Generated trace file %s with %lu operations\n", argv[1], numCalls(gen));
+
+    free(gen->live);
+    free(gen->positions);
+    free(gen->sizes);
+    free(gen->serials);
+    free(gen->free_ids);
+    free(gen->deaths);
+    free(gen);
+    free(phases);
+    return 0;
+}
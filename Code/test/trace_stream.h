@@ -0,0 +1,196 @@
+/**
+ * @file trace_stream.h
+ * @brief Streaming trace reader for the test driver, for traces that don't fit in memory.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * The trace is read in chunks of STREAM_CHUNK_REQS calls into two buffers. A background thread fills one buffer while the replay works through the other,
+ * so the replay only waits on I/O if the disk can't keep up. Text and binary traces are both supported, and neither needs the counts of the header.
+ * Binary traces are checked against their checksum as they stream, a mismatch is reported once the end is reached.
+ */
+
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+#include "trace_format.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// calls per chunk, two chunks are kept in memory
+#define STREAM_CHUNK_REQS (1 << 16)
+
+typedef struct
+{
+    FILE *fp;
+    int binary;
+    uint64_t checksum; // expected checksum of a binary trace
+    uint64_t hash;     // checksum of the records read so far
+
+    trace_req_t *chunks[2];
+    int counts[2]; // number of calls in the chunk, 0 at the end of the trace and -1 while the chunk is waiting to be filled
+    int next;      // chunk handed to the replay next
+    int held;      // chunk the replay is working on, -1 if none
+
+    int closing;
+    long line_number; // lines of a text trace read so far
+    long error_line;  // line of the first invalid call of a text trace
+    int corrupt;      // a binary trace was truncated or failed the checksum
+
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} trace_stream_t;
+
+// fills a chunk from the file, returns the number of calls read. 0 at the end of the trace, or after an error
+static int streamFill(trace_stream_t *stream, trace_req_t *chunk)
+{
+    if (stream->error_line || stream->corrupt)
+        return 0;
+
+    if (stream->binary)
+    {
+        size_t read = fread(chunk, sizeof(trace_req_t), STREAM_CHUNK_REQS, stream->fp);
+        stream->hash = traceChecksum(stream->hash, chunk, read * sizeof(trace_req_t));
+
+        if (read < STREAM_CHUNK_REQS && stream->hash != stream->checksum)
+            stream->corrupt = 1;
+        return stream->corrupt ? 0 : (int)read;
+    }
+
+    char line[MAX_STRING_LENGTH];
+    int count = 0;
+
+    while (count < STREAM_CHUNK_REQS && fgets(line, sizeof(line), stream->fp) != NULL)
+    {
+        stream->line_number++;
+
+        int result = traceParseLine(line, &chunk[count]);
+        if (result > 0)
+        {
+            stream->error_line = stream->line_number;
+            return 0;
+        }
+        if (result == 0)
+            count++;
+    }
+    return count;
+}
+
+static void *streamReader(void *arg)
+{
+    trace_stream_t *stream = (trace_stream_t *)arg;
+
+    for (int chunk = 0;; chunk ^= 1)
+    {
+        pthread_mutex_lock(&stream->lock);
+        while (stream->counts[chunk] != -1 && !stream->closing)
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        int closing = stream->closing;
+        pthread_mutex_unlock(&stream->lock);
+
+        if (closing)
+            break;
+
+        int count = streamFill(stream, stream->chunks[chunk]);
+
+        pthread_mutex_lock(&stream->lock);
+        stream->counts[chunk] = count;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+
+        if (count == 0)
+            break;
+    }
+    return NULL;
+}
+
+// opens the trace at path and starts reading ahead. returns 0 on success
+static int streamOpen(trace_stream_t *stream, const char *path)
+{
+    memset(stream, 0, sizeof(trace_stream_t));
+
+    stream->fp = fopen(path, "rb");
+    if (stream->fp == NULL)
+        return 1;
+
+    trace_binary_header_t header;
+    if (fread(&header, sizeof(header), 1, stream->fp) == 1 && memcmp(header.magic, TRACE_BINARY_MAGIC, TRACE_BINARY_MAGIC_SIZE) == 0)
+    {
+        if (header.version != TRACE_BINARY_VERSION || header.record_size != sizeof(trace_req_t))
+        {
+            fclose(stream->fp);
+            return 1;
+        }
+        stream->binary = 1;
+        stream->checksum = header.checksum;
+        stream->hash = TRACE_CHECKSUM_INIT;
+    }
+    else
+    {
+        rewind(stream->fp);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        stream->chunks[i] = (trace_req_t *)malloc(STREAM_CHUNK_REQS * sizeof(trace_req_t));
+        if (stream->chunks[i] == NULL)
+            return 1;
+        stream->counts[i] = -1;
+    }
+    stream->held = -1;
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    return pthread_create(&stream->reader, NULL, streamReader, stream);
+}
+
+// hands the chunk the replay was working on back to the reader, and waits for the next one.
+// returns the number of calls in the next chunk, or 0 at the end of the trace
+static int streamNext(trace_stream_t *stream, trace_req_t **reqs)
+{
+    pthread_mutex_lock(&stream->lock);
+
+    if (stream->held >= 0)
+    {
+        stream->counts[stream->held] = -1;
+        stream->held = -1;
+        pthread_cond_broadcast(&stream->cond);
+    }
+
+    while (stream->counts[stream->next] == -1)
+        pthread_cond_wait(&stream->cond, &stream->lock);
+
+    int count = stream->counts[stream->next];
+    if (count > 0)
+    {
+        *reqs = stream->chunks[stream->next];
+        stream->held = stream->next;
+        stream->next ^= 1;
+    }
+
+    pthread_mutex_unlock(&stream->lock);
+    return count;
+}
+
+static void streamClose(trace_stream_t *stream)
+{
+    pthread_mutex_lock(&stream->lock);
+    stream->closing = 1;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+
+    pthread_join(stream->reader, NULL);
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->cond);
+
+    fclose(stream->fp);
+    free(stream->chunks[0]);
+    free(stream->chunks[1]);
+}
+
+#endif // TRACE_STREAM_H
@@ -1,88 +1,218 @@
 import json
+import os
 import random
+import shutil
+import subprocess
+import sys
+from bisect import bisect
+from functools import partial
+from itertools import accumulate
+from multiprocessing import Pool
 
-def generate_trace_file(config):
-    trace_file = config["trace_file"]
-    num_operations = config["num_operations"]
-    params = config["params"]
-    probabilities = config["probabilities"]
-    seed = config["seed"]
+MALLOC, FREE, REALLOC = 0, 1, 2
+
+# operations buffered before they are written out
+WRITE_BATCH = 1 << 16
 
-    distribution = config["distribution"]
-    dist_function = random.gauss
+# generator of the traces with "phases", built by make traces
+ENGINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "build", "trace_gen.out")
 
+
+def get_dist_function(distribution, params):
     if distribution == "uniform":
-        dist_function = random.uniform
+        return random.uniform, params
     elif distribution == "lognormal":
-        dist_function = random.lognormvariate
+        return random.lognormvariate, params
     elif distribution == "exponential":
-        dist_function = random.expovariate
+        return random.expovariate, params
     elif distribution == "gamma":
-        dist_function = random.gammavariate
+        return random.gammavariate, params
     elif distribution == "normal":
-        dist_function = random.gauss
-    else:
-        print(f"Invalid distribution {distribution}, using gaussian distribution")
-        params = {
-            "mu": 100,
-            "sigma": 50
-        }
-
-    random.seed(seed)
-
-    allocations = {}  # To track allocated blocks
-
-    stats = {}  # To track stats
-    stats["alloc"] = 0
-    stats["free"] = 0
-    stats["realloc"] = 0
-    stats["total"] = 0
-
-    with open(trace_file, "w") as f:
-        for index in range(0, num_operations):
-            
-            if index == 0:
-                operation = "malloc"
-            else:
-                operation = random.choices(["malloc", "free", "realloc"], weights=probabilities)[0]
-
-            # If there are allocated blocks, randomly choose one for free or realloc
-            if operation != "malloc" and allocations:
-                allocated_index = random.choice(list(allocations.keys()))
-
-                if operation == "free":
-                    f.write(f"F {allocated_index}\n")
-                    stats["free"] += 1
-                    stats["total"] += 1
-                    del allocations[allocated_index]
-                elif operation == "realloc":
-                    allocation_size = max(1, int(dist_function(**params)))
-                    stats["realloc"] += 1
-                    stats["total"] += 1
-                    f.write(f"R {allocated_index} {allocation_size}\n")
-
-            # For malloc, generate a new allocation and track it
-            elif operation == "malloc":
-                allocation_size = max(1, int(dist_function(**params)))
-                allocations[index] = allocation_size
-                stats["alloc"] += 1
-                stats["total"] += 1
-                f.write(f"M {index} {allocation_size}\n")
-
-    print(f"Generated trace file {trace_file} with {stats['total']} operations")
-
-    # put the header in the file
-    with open(trace_file, "r") as f:
-        content = f.read()
-    with open(trace_file, "w") as f:
-        f.write(f"{stats['total']}\n")
-        f.write(f"{stats['alloc']}\n")
-        f.write(f"{stats['free']}\n")
-        f.write(f"{stats['realloc']}\n")
-        f.write(content)
+        return random.gauss, params
+
+    print(f"Invalid distribution {distribution}, using gaussian distribution")
+    return random.gauss, {"mu": 100, "sigma": 50}
+
+
+def size_sampler(config):
+    dist_function, params = get_dist_function(config["distribution"], config["params"])
+    draw = partial(dist_function, **params)
+    return lambda: max(1, int(draw()))
+
+
+class TraceWriter:
+    """Writes operations in batches to a temporary body, and puts the header in front of it once the counts are known."""
+
+    def __init__(self, trace_file, num_threads):
+        self.trace_file = trace_file
+        self.body_file = trace_file + ".body"
+        self.body = open(self.body_file, "w")
+        self.lines = []
+        self.written = 0
+        self.num_threads = num_threads
+        self.stats = {"alloc": 0, "free": 0, "realloc": 0, "total": 0}
+
+    def prefix(self):
+        # multi threaded traces prefix every operation with the id of the thread that issues it.
+        # a block may be freed or realloc'd by any thread, not just the one that allocated it
+        return f"{random.randrange(self.num_threads)} " if self.num_threads > 1 else ""
+
+    def flush(self):
+        self.body.write("".join(self.lines))
+        self.written += len(self.lines)
+        self.lines.clear()
+
+    def write(self, line, operation):
+        self.lines.append(line)
+        self.stats[operation] += 1
+        if len(self.lines) >= WRITE_BATCH:
+            self.flush()
+
+    def close(self):
+        self.flush()
+        self.body.close()
+
+        stats = self.stats
+        stats["total"] = stats["alloc"] + stats["free"] + stats["realloc"]
+        with open(self.trace_file, "w") as f:
+            f.write(f"{stats['total']}\n")
+            f.write(f"{stats['alloc']}\n")
+            f.write(f"{stats['free']}\n")
+            f.write(f"{stats['realloc']}\n")
+            with open(self.body_file, "r") as body:
+                shutil.copyfileobj(body, f, 1 << 20)
+        os.remove(self.body_file)
+
+        print(f"Generated trace file {self.trace_file} with {stats['total']} operations")
+
+
+class FenwickTree:
+    """Counts of live blocks by position, used to pick the k-th live block in allocation order in O(log n)."""
+
+    def __init__(self, size):
+        self.size = size
+        self.tree = [0] * (size + 1)
+        self.top = 1 << size.bit_length()
+
+    def add(self, index, delta):
+        index += 1
+        while index <= self.size:
+            self.tree[index] += delta
+            index += index & -index
+
+    def select(self, k):
+        # position of the k-th (0 based) set element
+        position = 0
+        step = self.top
+        while step:
+            next_position = position + step
+            if next_position <= self.size and self.tree[next_position] <= k:
+                position = next_position
+                k -= self.tree[next_position]
+            step >>= 1
+        return position
+
+
+def generate_random_trace(config, writer):
+    # every operation is drawn with the given probabilities, and frees/reallocs pick a random live block.
+    # the draws are the ones random.choices and random.choice(list(allocations.keys())) made, the victim being the k-th live block
+    # in allocation order, so the traces of existing configs stay the same
+    num_operations = config["num_operations"]
+    cum_weights = list(accumulate(config["probabilities"]))
+    total = cum_weights[-1] + 0.0
+    draw_size = size_sampler(config)
+
+    live = FenwickTree(num_operations)
+    num_live = 0
+
+    for index in range(0, num_operations):
+        thread = writer.prefix()
+
+        if index == 0:
+            operation = MALLOC
+        else:
+            operation = bisect(cum_weights, random.random() * total, 0, 2)
+
+        # If there are allocated blocks, randomly choose one for free or realloc
+        if operation != MALLOC and num_live:
+            allocated_index = live.select(random.randrange(num_live))
+
+            if operation == FREE:
+                writer.write(f"{thread}F {allocated_index}\n", "free")
+                live.add(allocated_index, -1)
+                num_live -= 1
+            elif operation == REALLOC:
+                writer.write(f"{thread}R {allocated_index} {draw_size()}\n", "realloc")
+
+        # For malloc, generate a new allocation and track it
+        elif operation == MALLOC:
+            writer.write(f"{thread}M {index} {draw_size()}\n", "alloc")
+            live.add(index, 1)
+            num_live += 1
+
+
+# parameters of the distributions, in the order the C generator takes them
+DIST_PARAMS = {
+    "uniform": ["a", "b"],
+    "normal": ["mu", "sigma"],
+    "lognormal": ["mu", "sigma"],
+    "exponential": ["lambd"],
+    "gamma": ["alpha", "beta"],
+}
+
+
+def engine_distribution(distribution, params):
+    return ":".join([distribution] + [str(params[name]) for name in DIST_PARAMS[distribution]])
+
+
+def engine_options(options):
+    # turns a config or phase into key=value arguments of the C generator (see test/trace_gen.c)
+    args = []
+    for key, value in options.items():
+        if key in ("trace_file", "phases", "params", "pattern"):
+            continue
+        elif key == "num_operations":
+            args.append(f"ops={value}")
+        elif key == "distribution":
+            args.append(f"size={engine_distribution(value, options['params'])}")
+        elif key == "lifetime":
+            args.append(f"lifetime={engine_distribution(value['distribution'], value['params'])}")
+        elif isinstance(value, list):
+            args.append(f"{key}={':'.join(str(v) for v in value)}")
+        else:
+            args.append(f"{key}={int(value) if isinstance(value, bool) else value}")
+    return args
+
+
+def generate_phased_trace(config):
+    # phased traces are generated in C, a python loop can't make 100M+ calls in reasonable time
+    if not os.path.exists(ENGINE):
+        print(f"{ENGINE} not found, build it with make traces")
+        sys.exit(1)
+
+    args = [ENGINE, config["trace_file"]] + engine_options(config)
+    for phase in config["phases"]:
+        args += [f"phase={phase['pattern']}"] + engine_options(phase)
+    subprocess.run(args, check=True)
+
+
+def generate_trace_file(config):
+    if "phases" in config:
+        generate_phased_trace(config)
+        return
+
+    random.seed(config["seed"])
+    writer = TraceWriter(config["trace_file"], config.get("threads", 1))
+    generate_random_trace(config, writer)
+    writer.close()
+
 
 if __name__ == "__main__":
+    # usage: python3 trace_gen.py [trace names...], generates every trace of trace_config.json by default.
+    # every trace has its own seed, so they are generated in parallel
     with open("trace_config.json", "r") as config_file:
         configs = json.load(config_file)
-        for config in configs:
-            generate_trace_file(config)
\ No newline at end of file
+
+    configs = [config for config in configs if len(sys.argv) < 2 or config["trace_file"] in sys.argv[1:]]
+    with Pool(max(1, min(len(configs), os.cpu_count()))) as pool:
+        pool.map(generate_trace_file, configs, chunksize=1)